@@ -0,0 +1,127 @@
+// region allocator, memory is freed a block at a time
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdalign.h>
+#include <string.h>
+#include <assert.h>
+
+#include "arena.h"
+
+// macro for dumping error messages
+#ifndef DUMP_ERR
+#define DUMP_ERR(ptr, str)				\
+	if (ptr == NULL) {				\
+		perror(str);				\
+		exit(EXIT_FAILURE);			\
+	}
+#endif
+
+// default block size
+#define BLOCK_SIZE (64 * 1024)
+// every allocation is aligned for any type
+#define ALIGN alignof(max_align_t)
+
+struct block {
+	struct block *next;
+	size_t size;		// bytes in @data
+	size_t used;		// bytes of @data handed out
+	max_align_t data[];
+};
+
+struct _arena {
+	struct block *head;	// block allocations are made from
+	size_t block_size;
+	struct arena_stats st;
+};
+
+// create an arena handing out blocks of @block_size bytes, 0 for the
+// default
+arena_t new_arena(size_t block_size)
+{
+	arena_t a = malloc(sizeof(struct _arena));
+	DUMP_ERR(a, "malloc failed");
+	a->head = NULL;
+	a->block_size = block_size ? block_size : BLOCK_SIZE;
+	memset(&a->st, 0, sizeof(a->st));
+	return a;
+}
+
+// take a block of at least @size bytes from malloc
+static struct block *new_block(arena_t a, size_t size)
+{
+	struct block *b = malloc(sizeof(struct block) + size);
+	DUMP_ERR(b, "malloc failed");
+	b->size = size;
+	b->used = 0;
+	a->st.nblocks++;
+	a->st.peak += sizeof(struct block) + size;
+	return b;
+}
+
+/*
+ * arena_alloc - allocate @size bytes from @a
+ *
+ * The memory lives until free_arena. Requests larger than a quarter of
+ * a block get a block of their own, put behind the current one so its
+ * free space is not wasted.
+ */
+void *arena_alloc(arena_t a, size_t size)
+{
+	assert(a);
+	size = (size + ALIGN - 1) / ALIGN * ALIGN;
+	if (size == 0) size = ALIGN;
+
+	struct block *b = a->head;
+	if (b == NULL || b->size - b->used < size) {
+		if (size > a->block_size / 4) {
+			b = new_block(a, size);
+			if (a->head) {
+				b->next = a->head->next;
+				a->head->next = b;
+			} else {
+				b->next = NULL;
+				a->head = b;
+			}
+		} else {
+			b = new_block(a, a->block_size);
+			b->next = a->head;
+			a->head = b;
+		}
+	}
+
+	void *p = (char *)b->data + b->used;
+	b->used += size;
+	a->st.nalloc++;
+	a->st.used += size;
+	return p;
+}
+
+// copy @str into @a
+char *arena_strdup(arena_t a, const char *str)
+{
+	const size_t len = strlen(str) + 1;
+	char *copy = arena_alloc(a, len);
+	memcpy(copy, str, len);
+	return copy;
+}
+
+// report what @a has handed out and taken from malloc so far
+void arena_stats(arena_t a, struct arena_stats *st)
+{
+	assert(a && st);
+	*st = a->st;
+}
+
+// free every allocation made from @a at once
+void free_arena(arena_t a)
+{
+	if (a == NULL) return;
+	struct block *b = a->head;
+	while (b) {
+		struct block *next = b->next;
+		free(b);
+		b = next;
+	}
+	free(a);
+}
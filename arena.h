@@ -0,0 +1,28 @@
+// arena.h ... Interface to a region (bump) allocator
+//
+// Memory is handed out from large blocks and only given back all at
+// once, by free_arena, which frees one block at a time instead of one
+// object at a time. An ADT constructed with an arena allocates its
+// nodes and strings from it; several ADTs may share one.
+
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+typedef struct _arena *arena_t;
+
+struct arena_stats {
+	long nalloc;	// calls to arena_alloc
+	long nblocks;	// blocks taken from malloc
+	size_t used;	// bytes handed out
+	size_t peak;	// bytes taken from malloc, none is returned early
+};
+
+arena_t new_arena(size_t);
+void *arena_alloc(arena_t, size_t);
+char *arena_strdup(arena_t, const char *);
+void arena_stats(arena_t, struct arena_stats *);
+void free_arena(arena_t);
+
+#endif
@@ -0,0 +1,424 @@
+// benchmark harness for pagerank, inverted and the search tools
+//
+// Runs the tools on a collection, such as one written by webgen, and
+// prints the wall time of every phase as JSON:
+//
+//	graph_build	pagerank stopped before its first iteration
+//	pagerank	a full pagerank run
+//	iterations	the difference of the two medians
+//	index_build	inverted
+//	query_*		latency of single queries sent to searchPagerank
+//			and searchTfIdf in -d mode, so start up is excluded
+//
+// Each phase reports the median (p50) and p99 of its samples. With -o,
+// full pagerank runs are also timed for every listed url order (see
+// reorder.h) and "none", next to the mean log gap, LLC misses and cycles
+// per edge of the iterations that one more run with --perf reports;
+// counters the machine does not have are null. -o none leaves the
+// orders out.
+
+// fork, exec, pipes and clock_gettime are POSIX, realpath is XSI
+#define _XOPEN_SOURCE 700
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#define DUMP_ERR(ptr, str)				\
+	if (ptr == NULL) {				\
+		perror(str);				\
+		exit(EXIT_FAILURE);			\
+	}
+
+// terms per query are 1 to MAX_TERMS
+#define MAX_TERMS 3
+
+static unsigned long long rng = 88172645463325252ULL;
+
+// xorshift64, deterministic across runs
+static unsigned long long next_rand(void)
+{
+	rng ^= rng << 13;
+	rng ^= rng >> 7;
+	rng ^= rng << 17;
+	return rng;
+}
+
+static double now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+int _double_cmp(const void *a, const void *b)
+{
+	double da = *(double *)a;
+	double db = *(double *)b;
+	return (da > db) - (da < db);
+}
+
+// nearest rank percentile @p of @n samples, sorts @x
+static double percentile(double *x, int n, double p)
+{
+	qsort(x, n, sizeof(double), _double_cmp);
+	int rank = (int)(p / 100 * n + 0.999999);
+	if (rank < 1) rank = 1;
+	return x[rank - 1];
+}
+
+// path of tool @name in @bin
+static char *tool(const char *bin, const char *name)
+{
+	char *path = malloc(strlen(bin) + strlen(name) + 2);
+	DUMP_ERR(path, "malloc failed");
+	sprintf(path, "%s/%s", bin, name);
+	return path;
+}
+
+// run @argv with stdout discarded, return its wall time in seconds
+static double run(char **argv)
+{
+	const double start = now();
+	pid_t pid = fork();
+	if (pid < 0) {
+		perror("fork failed");
+		exit(EXIT_FAILURE);
+	}
+	if (pid == 0) {
+		int null = open("/dev/null", O_WRONLY);
+		if (null >= 0) dup2(null, STDOUT_FILENO);
+		execv(argv[0], argv);
+		perror(argv[0]);
+		_exit(127);
+	}
+
+	int status;
+	waitpid(pid, &status, 0);
+	if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+		fprintf(stderr, "%s failed\n", argv[0]);
+		exit(EXIT_FAILURE);
+	}
+	return now() - start;
+}
+
+// time @runs runs of @argv after an untimed one that warms the page
+// cache, return the samples
+static double *time_runs(char **argv, int runs)
+{
+	double *t = malloc(runs * sizeof(double));
+	DUMP_ERR(t, "malloc failed");
+	run(argv);
+	for (int i = 0; i < runs; i++)
+		t[i] = run(argv);
+	return t;
+}
+
+// read the words of invertedIndex.txt
+static char **read_words(int *n)
+{
+	FILE *fp = fopen("invertedIndex.txt", "r");
+	DUMP_ERR(fp, "invertedIndex.txt");
+
+	int max = 1024;
+	char **words = malloc(max * sizeof(char *));
+	DUMP_ERR(words, "malloc failed");
+	*n = 0;
+
+	char *line = NULL;
+	size_t cap = 0;
+	while (getline(&line, &cap, fp) != -1) {
+		char *word = strtok(line, " \n");
+		if (word == NULL) continue;
+		if (*n == max) {
+			max *= 2;
+			char **tmp = realloc(words, max * sizeof(char *));
+			DUMP_ERR(tmp, "realloc failed");
+			words = tmp;
+		}
+		words[*n] = strdup(word);
+		DUMP_ERR(words[*n], "strdup failed");
+		(*n)++;
+	}
+	free(line);
+	fclose(fp);
+	return words;
+}
+
+/*
+ * time_queries - latency of @nq queries answered by @path in -d mode
+ *
+ * Queries are 1 to MAX_TERMS random words of the index, sent one at a
+ * time; the time of each is taken from writing it to reading the blank
+ * line that ends its results.
+ */
+static double *time_queries(char *path, char **words, int nwords, int nq)
+{
+	int to[2], from[2];
+	if (pipe(to) != 0 || pipe(from) != 0) {
+		perror("pipe failed");
+		exit(EXIT_FAILURE);
+	}
+	pid_t pid = fork();
+	if (pid < 0) {
+		perror("fork failed");
+		exit(EXIT_FAILURE);
+	}
+	if (pid == 0) {
+		dup2(to[0], STDIN_FILENO);
+		dup2(from[1], STDOUT_FILENO);
+		close(to[0]);
+		close(to[1]);
+		close(from[0]);
+		close(from[1]);
+		execl(path, path, "-d", (char *)NULL);
+		perror(path);
+		_exit(127);
+	}
+	close(to[0]);
+	close(from[1]);
+	FILE *out = fdopen(to[1], "w");
+	FILE *in = fdopen(from[0], "r");
+	DUMP_ERR(out, "fdopen failed");
+	DUMP_ERR(in, "fdopen failed");
+
+	double *t = malloc((nq + 1) * sizeof(double));
+	DUMP_ERR(t, "malloc failed");
+	char *line = NULL;
+	size_t cap = 0;
+	for (int q = 0; q < nq; q++) {
+		const int nterms = 1 + next_rand() % MAX_TERMS;
+		const double start = now();
+		for (int i = 0; i < nterms; i++)
+			fprintf(out, "%s%c", words[next_rand() % nwords],
+				i == nterms - 1 ? '\n' : ' ');
+		fflush(out);
+
+		// results end with an empty line
+		ssize_t len;
+		while ((len = getline(&line, &cap, in)) > 1)
+			;
+		if (len < 0) {
+			fprintf(stderr, "%s exited early\n", path);
+			exit(EXIT_FAILURE);
+		}
+		t[q] = now() - start;
+	}
+	free(line);
+	fclose(out);
+	fclose(in);
+	waitpid(pid, NULL, 0);
+	return t;
+}
+
+// value @key of the stats report at @path, NAN if it is not there
+static double stat_value(const char *path, const char *key)
+{
+	FILE *fp = fopen(path, "r");
+	DUMP_ERR(fp, path);
+	double v = NAN;
+	char *line = NULL;
+	size_t cap = 0;
+	const size_t len = strlen(key);
+	while (getline(&line, &cap, fp) != -1) {
+		char *s = strstr(line, key);
+		if (s && s > line && s[-1] == '"' && s[len] == '"') {
+			v = atof(strchr(s + len, ':') + 1);
+			break;
+		}
+	}
+	free(line);
+	fclose(fp);
+	return v;
+}
+
+// print @v as a JSON number, null if NAN
+static void print_value(const char *name, double v, int last)
+{
+	if (isnan(v))
+		printf("\"%s\": null%s", name, last ? "" : ", ");
+	else
+		printf("\"%s\": %.4g%s", name, v, last ? "" : ", ");
+}
+
+/*
+ * time_order - time full pagerank runs in url order @order
+ *
+ * "none" keeps the ids of the collection. One more run writes its stats
+ * to a file in the collection, which the locality figures are read from.
+ */
+static void time_order(char *pagerank, char *threads, char *order, int runs,
+		       int last)
+{
+	const char *path = "order_stats.json";
+	char *argv[12] = { pagerank, "-t", threads };
+	int n = 3;
+	if (strcmp(order, "none") != 0) {
+		argv[n++] = "-r";
+		argv[n++] = order;
+	}
+	char **args = argv + n;
+	args[0] = "0.85";
+	args[1] = "0.00001";
+	args[2] = "1000";
+	double *t = time_runs(argv, runs);
+
+	args[0] = "--perf";
+	args[1] = "--stats=order_stats.json";
+	args[2] = "0.85";
+	args[3] = "0.00001";
+	args[4] = "1000";
+	run(argv);
+
+	printf("    \"%s\": { \"samples\": %d, \"p50_ms\": %.3f, "
+	       "\"p99_ms\": %.3f, ", order, runs, percentile(t, runs, 50) * 1e3,
+	       percentile(t, runs, 99) * 1e3);
+	print_value("log_gap_before", stat_value(path, "reorder.log_gap_before"),
+		    0);
+	print_value("log_gap_after", stat_value(path, "reorder.log_gap_after"),
+		    0);
+	print_value("llc_misses_per_edge",
+		    stat_value(path, "iterate.llc_misses_per_edge"), 0);
+	print_value("cycles_per_edge",
+		    stat_value(path, "iterate.cycles_per_edge"), 1);
+	printf(" }%s\n", last ? "" : ",");
+	remove(path);
+	free(t);
+}
+
+// print one phase, times in milliseconds
+static void print_phase(const char *name, double *t, int n, int last)
+{
+	printf("    \"%s\": { \"samples\": %d, \"p50_ms\": %.3f, "
+	       "\"p99_ms\": %.3f }%s\n", name, n,
+	       percentile(t, n, 50) * 1e3, percentile(t, n, 99) * 1e3,
+	       last ? "" : ",");
+}
+
+int main(int argc, char **argv)
+{
+	int runs = 5;
+	int nq = 1000;
+	char *threads = "1";
+	char *bin = ".";
+	char *orders = NULL;
+	int c;
+
+	while ((c = getopt(argc, argv, "r:q:t:b:o:")) != -1) {
+		switch (c) {
+		case 'r':
+			runs = atoi(optarg);
+			break;
+		case 'q':
+			nq = atoi(optarg);
+			break;
+		case 't':
+			threads = optarg;
+			break;
+		case 'b':
+			bin = optarg;
+			break;
+		case 'o':
+			// -o none, as make bench passes it, times no orders
+			orders = strcmp(optarg, "none") == 0 ? NULL : optarg;
+			break;
+		default:
+			argc = 0;
+		}
+	}
+
+	if (argc - optind != 1 || runs < 1 || nq < 1) {
+		fprintf(stderr, "Usage: %s [-r runs] [-q queries] [-t threads] "
+			"[-b bindir] [-o order,...] dir\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	// the tools read and write the collection's directory
+	char bindir[PATH_MAX];
+	if (realpath(bin, bindir) == NULL || chdir(argv[optind]) != 0) {
+		perror("Cannot find binaries or collection");
+		return EXIT_FAILURE;
+	}
+	char *pagerank = tool(bindir, "pagerank");
+	char *inverted = tool(bindir, "inverted");
+	char *search_pr = tool(bindir, "searchPagerank");
+	char *search_tfidf = tool(bindir, "searchTfIdf");
+
+	char *build_argv[] = { pagerank, "-t", threads, "0.85", "0.00001", "0",
+			       NULL };
+	char *pr_argv[] = { pagerank, "-t", threads, "0.85", "0.00001", "1000",
+			    NULL };
+	char *inv_argv[] = { inverted, "-t", threads, NULL };
+
+	// build and full runs alternate, after a warm up run, so both see
+	// the same machine state
+	double *build = malloc(runs * sizeof(double));
+	double *pr = malloc(runs * sizeof(double));
+	DUMP_ERR(build, "malloc failed");
+	DUMP_ERR(pr, "malloc failed");
+	run(pr_argv);
+	for (int i = 0; i < runs; i++) {
+		build[i] = run(build_argv);
+		pr[i] = run(pr_argv);
+	}
+	double *inv = time_runs(inv_argv, runs);
+
+	int nwords = 0;
+	char **words = read_words(&nwords);
+	if (nwords == 0) {
+		fprintf(stderr, "empty index\n");
+		return EXIT_FAILURE;
+	}
+	double *q_pr = time_queries(search_pr, words, nwords, nq);
+	double *q_tfidf = time_queries(search_tfidf, words, nwords, nq);
+
+	printf("{\n  \"collection\": \"%s\",\n", argv[optind]);
+	printf("  \"runs\": %d,\n  \"threads\": %s,\n  \"words\": %d,\n",
+	       runs, threads, nwords);
+	printf("  \"phases\": {\n");
+	print_phase("graph_build", build, runs, 0);
+	print_phase("pagerank", pr, runs, 0);
+	const double iter = percentile(pr, runs, 50) -
+		percentile(build, runs, 50);
+	printf("    \"iterations\": { \"p50_ms\": %.3f },\n", iter * 1e3);
+	print_phase("index_build", inv, runs, 0);
+	print_phase("query_pagerank", q_pr, nq, 0);
+	print_phase("query_tfidf", q_tfidf, nq, 1);
+	if (orders) {
+		printf("  },\n  \"orders\": {\n");
+		// the collection's own order first, and only once
+		char *list = malloc(strlen(orders) + sizeof("none,"));
+		DUMP_ERR(list, "malloc failed");
+		sprintf(list, "none,%s", orders);
+		char *o = strtok(list, ",");
+		while (o) {
+			char *next = strtok(NULL, ",");
+			while (next && strcmp(next, "none") == 0)
+				next = strtok(NULL, ",");
+			time_order(pagerank, threads, o, runs, next == NULL);
+			o = next;
+		}
+		free(list);
+	}
+	printf("  }\n}\n");
+
+	for (int i = 0; i < nwords; i++)
+		free(words[i]);
+	free(words);
+	free(build);
+	free(pr);
+	free(inv);
+	free(q_pr);
+	free(q_tfidf);
+	free(pagerank);
+	free(inverted);
+	free(search_pr);
+	free(search_tfidf);
+	return 0;
+}
@@ -0,0 +1,88 @@
+// doc id <-> url mapping
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <assert.h>
+#include <string.h>
+
+#include "doctab.h"
+#include "strtab.h"
+
+// macro for dumping error messages
+#ifndef DUMP_ERR
+#define DUMP_ERR(ptr, str)				\
+	if (ptr == NULL) {				\
+		perror(str);				\
+		exit(EXIT_FAILURE);			\
+	}
+#endif
+
+// urls are interned in alphabetical order, so the intern id is the doc id
+struct _doctab {
+	strtab_t urls;
+};
+
+int _str_cmp(const void *a, const void *b)
+{
+	return strcmp(*(char **)a, *(char **)b);
+}
+
+// build the table from the urls in @cltn
+doctab_t new_doctab(handle_t cltn)
+{
+	assert(cltn);
+	doctab_t t = malloc(sizeof(struct _doctab));
+	DUMP_ERR(t, "malloc failed");
+
+	const int n = handle_size(cltn);
+	char **sorted = malloc((n + 1) * sizeof(char *));
+	DUMP_ERR(sorted, "malloc failed");
+	for (int i = 0; i < n; i++)
+		sorted[i] = getbuf(cltn, i);
+	qsort(sorted, n, sizeof(char *), _str_cmp);
+
+	// duplicated urls share one id
+	t->urls = new_strtab();
+	for (int i = 0; i < n; i++)
+		intern_str(t->urls, sorted[i]);
+	free(sorted);
+
+	return t;
+}
+
+// build the table from a collection file
+doctab_t read_doctab(char *path)
+{
+	handle_t cltn = parse(path);
+	doctab_t t = new_doctab(cltn);
+	free_handle(cltn);
+	return t;
+}
+
+void free_doctab(doctab_t t)
+{
+	if (t == NULL) return;
+	free_strtab(t->urls);
+	free(t);
+}
+
+// doc id of @url, -1 if it is not in the collection
+int doc_id(doctab_t t, char *url)
+{
+	assert(t);
+	return find_str(t->urls, url);
+}
+
+// the table is never modified after it is built, so the name stays valid
+// until free_doctab
+char *doc_url(doctab_t t, int id)
+{
+	assert(t);
+	return id_to_str(t->urls, id);
+}
+
+int ndocs(doctab_t t)
+{
+	assert(t);
+	return strtab_size(t->urls);
+}
@@ -0,0 +1,21 @@
+// doctab.h ... Interface to the table of documents in a collection
+//
+// Every url of collection.txt gets a 32-bit doc id. Ids follow the
+// alphabetical order of the urls, so a list of doc ids sorted by id is
+// also sorted by url.
+
+#ifndef DOCTAB_H
+#define DOCTAB_H
+
+#include "parser.h"
+
+typedef struct _doctab *doctab_t;
+
+doctab_t new_doctab(handle_t);
+doctab_t read_doctab(char *);
+void free_doctab(doctab_t);
+int doc_id(doctab_t, char *);
+char *doc_url(doctab_t, int);
+int ndocs(doctab_t);
+
+#endif
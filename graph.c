@@ -1,9 +1,18 @@
+// mmap, open and fstat are POSIX
+#define _POSIX_C_SOURCE 200809L
+
 #include <stdlib.h>
 #include <stdio.h>
 #include <assert.h>
 #include <string.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #include "graph.h"
+#include "strtab.h"
 
 // macro for dumping error messages
 #ifndef DUMP_ERR
@@ -14,40 +23,102 @@
 	}
 #endif
 
-// use uchar to save memory when representing an "edge"
-// uchar == 1: has edge
-// uchar == 0: no edge
-typedef unsigned char uchar;
+// edges are staged as (src, dest) pairs by add_edge and compressed into
+// sparse row/column arrays the first time the graph is queried
+//
+// out-links of v: out_adj[out_off[v] .. out_off[v + 1]) (csr)
+// in-links of v:  in_adj[in_off[v] .. in_off[v + 1])    (csc)
+//
+// both adjacency lists are sorted by vertex id and free of duplicates
+//
+// a graph returned by load_graph points straight into the mapped snapshot
+// and only copies it to the heap if add_edge is called on it
 struct _graph {
 	// @nv - number of vertices
-	// @ne - number of edges
-	// @max_v - maximum number of vertices (not used)
-	// @max_e - maximum number of edges
+	// @ne - number of edges in the compressed arrays
+	// @nbuilt - number of vertices covered by the compressed arrays
+	// @npend - number of staged edges
+	// @max_pend - maximum number of staged edges
 	int nv;
 	int ne;
-	int max_v;
-	int max_e;
-	// @vertex - vertex name
-	// @edges - adj matrix
-	char **vertex;
-	uchar **edges;
+	int nbuilt;
+	int npend;
+	int max_pend;
+	// @vertex - vertex names, interned to their ids
+	// @pend - staged edges, pend[2i] -> pend[2i + 1]
+	strtab_t vertex;
+	int *pend;
+	// @out_off, @out_adj - out-links (csr)
+	// @in_off, @in_adj - in-links (csc)
+	int *out_off;
+	int *out_adj;
+	int *in_off;
+	int *in_adj;
+	// @map, @map_len - snapshot mapped by load_graph, NULL otherwise
+	// @snap_names - vertex names inside the snapshot, '\0' separated
+	// @snap_noff - offset of each name in @snap_names
+	// @snap_stamp - what the snapshot was built from, see save_graph
+	void *map;
+	size_t map_len;
+	const char *snap_names;
+	const uint64_t *snap_noff;
+	const uint64_t *snap_stamp;
+	int snap_nstamp;
+};
+
+/*
+ * snapshot file layout, every section in native byte order:
+ *
+ *	header
+ *	out_off[nv + 1], out_adj[ne]	int32, csr
+ *	in_off[nv + 1], in_adj[ne]	int32, csc
+ *	name_off[nv]			uint64, 8 byte aligned
+ *	names				'\0' separated vertex names
+ *	stamp[nstamp]			uint64, 8 byte aligned
+ */
+#define SNAP_MAGIC "PRGRAPH"
+#define SNAP_VERSION 2
+
+struct snap_header {
+	char magic[8];
+	uint32_t version;
+	uint32_t nv;
+	uint32_t ne;
+	uint32_t int_size;	// sizeof(int) of the writer
+	uint64_t names_len;
+	uint64_t nstamp;
 };
 
+// byte offset of each section, the last entry is the file size
+enum { SEC_OUT_OFF, SEC_OUT_ADJ, SEC_IN_OFF, SEC_IN_ADJ, SEC_NAME_OFF,
+       SEC_NAMES, SEC_STAMP, SEC_END };
+
 static int get_vertex_id(graph_t, char *);
 static int add_vertex(graph_t, char *);
-static void add_mtrx_size(graph_t g);
+static void add_pend_size(graph_t);
+static void build_graph(graph_t);
+static void intern_names(graph_t);
+static void unmap_graph(graph_t);
+static void snap_layout(size_t, size_t, size_t, size_t, size_t *);
 
 // create empty graph
 graph_t new_graph(void)
 {
 	graph_t new = malloc(sizeof(struct _graph));
 	assert(new);
-	
-	new->nv = new->max_v = 0;
-	new->ne = new->max_e = 0;
-	new->max_e = 0;
-	new->vertex = NULL;
-	new->edges = NULL;
+
+	new->nv = new->ne = new->nbuilt = 0;
+	new->npend = new->max_pend = 0;
+	new->vertex = new_strtab();
+	new->pend = NULL;
+	new->out_off = new->out_adj = NULL;
+	new->in_off = new->in_adj = NULL;
+	new->map = NULL;
+	new->map_len = 0;
+	new->snap_names = NULL;
+	new->snap_noff = NULL;
+	new->snap_stamp = NULL;
+	new->snap_nstamp = 0;
 
 	return new;
 }
@@ -56,68 +127,162 @@ graph_t new_graph(void)
 void free_graph(graph_t g)
 {
 	if (g == NULL) return;
-	
-	for (int i = 0; i < g->nv; i++)
-		free(g->vertex[i]);
 
-	for (int i = 0; i < g->max_e; i++)
-		free(g->edges[i]);
-
-	free(g->vertex);
-	free(g->edges);
+	free_strtab(g->vertex);
+	free(g->pend);
+	if (g->map) {
+		munmap(g->map, g->map_len);
+	} else {
+		free(g->out_off);
+		free(g->out_adj);
+		free(g->in_off);
+		free(g->in_adj);
+	}
 	free(g);
 }
 
-// doules g->edges' row and column size
-static void add_mtrx_size(graph_t g)
+// doubles the staged edge buffer
+static void add_pend_size(graph_t g)
 {
 	assert(g);
 
-	int new_size = g->ne == 0 ? 1 : 2 * g->ne;
-	uchar **tmp = realloc(g->edges, new_size * sizeof(uchar *));
+	int new_size = g->max_pend == 0 ? 16 : 2 * g->max_pend;
+	int *tmp = realloc(g->pend, 2 * (size_t)new_size * sizeof(int));
 	DUMP_ERR(tmp, "realloc failed");
 
-	g->edges = tmp;
-	// init new row ptrs to NULL
-	for (int i = g->ne; i < new_size; i++) g->edges[i] = NULL;
-	for (int i = 0; i < new_size; i++) {
-		uchar *tmp = realloc(g->edges[i], new_size * sizeof(uchar));
-		DUMP_ERR(tmp, "realloc failed");
+	g->pend = tmp;
+	g->max_pend = new_size;
+}
 
-		g->edges[i] = tmp;
-		// init new columns with 0
-		for (int j = g->ne; j < new_size; j++) g->edges[i][j] = 0;
-	}
-	// init new rows and columns with 0
-	for (int i = g->ne; i < new_size; i++) {
-		for (int j = 0; j < g->ne; j++)
-			g->edges[i][j] = 0;
+int add_edge(graph_t g, char *src, char *dest)
+{
+	assert(g);
+	// the snapshot is read only
+	if (g->map) unmap_graph(g);
+
+	// interning returns the existing id for known names
+	int v = add_vertex(g, src);
+	int w = add_vertex(g, dest);
+
+	// prevent self loop
+	if (v != w) {
+		if (g->npend >= g->max_pend) add_pend_size(g);
+		g->pend[2 * g->npend] = v;
+		g->pend[2 * g->npend + 1] = w;
+		g->npend++;
 	}
-	g->max_e = new_size;
+	return 1;
 }
 
-int add_edge(graph_t g, char *src, char *dest)
+/*
+ * build_graph - compress staged edges into the csr/csc arrays
+ *
+ * Edges already in the compressed arrays are merged with the staged ones,
+ * so add_edge may still be called after the graph has been queried.
+ * Two stable counting sorts (by dest, then by src) leave every row sorted,
+ * duplicates are then dropped in one sweep and the csc arrays are filled
+ * by walking the csr arrays in order, which keeps every column sorted too.
+ * Runs in O(V + E).
+ */
+static void build_graph(graph_t g)
 {
 	assert(g);
-	
-	int v = get_vertex_id(g, src);
-	if (v < 0) {
-		if (g->ne >= g->max_e) add_mtrx_size(g);
-		g->ne++;
-		v = add_vertex(g, src);
+	if (g->out_off && g->npend == 0 && g->nbuilt == g->nv) return;
+
+	const int nv = g->nv;
+	const int total = g->ne + g->npend;
+	int *src = malloc(((size_t)total + 1) * sizeof(int));
+	int *dst = malloc(((size_t)total + 1) * sizeof(int));
+	int *tsrc = malloc(((size_t)total + 1) * sizeof(int));
+	int *tdst = malloc(((size_t)total + 1) * sizeof(int));
+	int *count = calloc((size_t)nv + 1, sizeof(int));
+	DUMP_ERR(src, "malloc failed");
+	DUMP_ERR(dst, "malloc failed");
+	DUMP_ERR(tsrc, "malloc failed");
+	DUMP_ERR(tdst, "malloc failed");
+	DUMP_ERR(count, "calloc failed");
+
+	// gather old and staged edges
+	int n = 0;
+	// vertices added after the last build have no row yet
+	for (int v = 0; g->out_off && v < g->nbuilt; v++) {
+		for (int e = g->out_off[v]; e < g->out_off[v + 1]; e++) {
+			src[n] = v;
+			dst[n++] = g->out_adj[e];
+		}
+	}
+	for (int i = 0; i < g->npend; i++) {
+		src[n] = g->pend[2 * i];
+		dst[n++] = g->pend[2 * i + 1];
 	}
 
-	int w = get_vertex_id(g, dest);
-	if (w < 0) {
-		if (g->ne >= g->max_e) add_mtrx_size(g);
-		g->ne++;
-		w = add_vertex(g, dest);
+	// counting sort by dest into tsrc/tdst
+	for (int i = 0; i < n; i++) count[dst[i] + 1]++;
+	for (int v = 0; v < nv; v++) count[v + 1] += count[v];
+	for (int i = 0; i < n; i++) {
+		int pos = count[dst[i]]++;
+		tsrc[pos] = src[i];
+		tdst[pos] = dst[i];
 	}
 
-	// prevent self loop
-	if (v != w)
-		g->edges[v][w] = 1;
-	return 1;
+	// stable counting sort by src back into src/dst
+	memset(count, 0, ((size_t)nv + 1) * sizeof(int));
+	for (int i = 0; i < n; i++) count[tsrc[i] + 1]++;
+	for (int v = 0; v < nv; v++) count[v + 1] += count[v];
+	for (int i = 0; i < n; i++) {
+		int pos = count[tsrc[i]]++;
+		src[pos] = tsrc[i];
+		dst[pos] = tdst[i];
+	}
+	free(tsrc);
+	free(tdst);
+
+	// drop duplicated edges and build csr
+	int *out_off = calloc((size_t)nv + 1, sizeof(int));
+	DUMP_ERR(out_off, "calloc failed");
+	int ne = 0;
+	for (int i = 0; i < n; i++) {
+		if (ne > 0 && src[i] == src[ne - 1] && dst[i] == dst[ne - 1])
+			continue;
+		src[ne] = src[i];
+		dst[ne++] = dst[i];
+		out_off[src[i] + 1]++;
+	}
+	for (int v = 0; v < nv; v++) out_off[v + 1] += out_off[v];
+	free(src);
+
+	int *out_adj = realloc(dst, ((size_t)ne + 1) * sizeof(int));
+	DUMP_ERR(out_adj, "realloc failed");
+
+	// transpose into csc
+	int *in_off = calloc((size_t)nv + 1, sizeof(int));
+	int *in_adj = malloc(((size_t)ne + 1) * sizeof(int));
+	DUMP_ERR(in_off, "calloc failed");
+	DUMP_ERR(in_adj, "malloc failed");
+	for (int e = 0; e < ne; e++) in_off[out_adj[e] + 1]++;
+	for (int v = 0; v < nv; v++) in_off[v + 1] += in_off[v];
+	memcpy(count, in_off, ((size_t)nv + 1) * sizeof(int));
+	for (int v = 0; v < nv; v++) {
+		for (int e = out_off[v]; e < out_off[v + 1]; e++)
+			in_adj[count[out_adj[e]]++] = v;
+	}
+	free(count);
+
+	free(g->out_off);
+	free(g->out_adj);
+	free(g->in_off);
+	free(g->in_adj);
+	g->out_off = out_off;
+	g->out_adj = out_adj;
+	g->in_off = in_off;
+	g->in_adj = in_adj;
+	g->ne = ne;
+
+	// staged edges are now part of the compressed arrays
+	free(g->pend);
+	g->pend = NULL;
+	g->npend = g->max_pend = 0;
+	g->nbuilt = nv;
 }
 
 // check if 2 vertices are connected directly
@@ -129,8 +294,21 @@ int is_connected(graph_t g, char *src, char *dest)
 
 	if (v < 0 || w < 0)
 		return 0;
-	else
-		return g->edges[v][w];
+
+	build_graph(g);
+	// rows are sorted, binary search the out-links of @v
+	int lo = g->out_off[v];
+	int hi = g->out_off[v + 1];
+	while (lo < hi) {
+		int mid = lo + (hi - lo) / 2;
+		if (g->out_adj[mid] == w)
+			return 1;
+		else if (g->out_adj[mid] < w)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return 0;
 }
 
 int nvertices(graph_t g)
@@ -139,15 +317,21 @@ int nvertices(graph_t g)
 	return g->nv;
 }
 
+// number of distinct edges, not counting self loops
+int nedges(graph_t g)
+{
+	assert(g);
+	build_graph(g);
+	return g->ne;
+}
+
 // count number of outgoing links of one node (doesnt count
 // self loop)
 int outdegree(graph_t g, int id)
 {
 	assert(g);
-	int count = 0;
-	for (int i = 0; i < g->ne; i++)
-		if (g->edges[id][i] && i != id) count++;
-	return count;
+	build_graph(g);
+	return g->out_off[id + 1] - g->out_off[id];
 }
 
 // count number of incoming links of one node (doesnt count
@@ -155,57 +339,68 @@ int outdegree(graph_t g, int id)
 int indegree(graph_t g, int id)
 {
 	assert(g);
-	int count = 0;
-	for (int i = 0; i < g->ne; i++)
-		if (g->edges[i][id] && i != id) count++;
-	return count;
+	build_graph(g);
+	return g->in_off[id + 1] - g->in_off[id];
 }
 
 // return a list of node id(s) that has outlink to @id
-int *nodes_to(graph_t g, int id, int *size)
+// the list is owned by the graph and stays valid until the next add_edge
+const int *nodes_to(graph_t g, int id, int *size)
 {
 	assert(g);
-	int *list = malloc(g->ne * sizeof(int));
-	DUMP_ERR(list, "malloc failed");
-	*size = 0;
-
-	for (int i = 0; i < g->ne; i++) {
-		if (g->edges[i][id] && i != id)
-			list[(*size)++] = i;
-	}
+	build_graph(g);
+	*size = g->in_off[id + 1] - g->in_off[id];
+	return &g->in_adj[g->in_off[id]];
+}
 
-	// shrink size
-	if (*size) {
-		int *tmp = realloc(list, *size * sizeof(int));
-		DUMP_ERR(tmp, "realloc failed");
-		list = tmp;
-	}
+// return a list of node id(s) that has inlinks from @id
+// the list is owned by the graph and stays valid until the next add_edge
+const int *nodes_from(graph_t g, int id, int *size)
+{
+	assert(g);
+	build_graph(g);
+	*size = g->out_off[id + 1] - g->out_off[id];
+	return &g->out_adj[g->out_off[id]];
+}
 
-	return list;
+// position of the first in-link of @id when the in-links of every vertex
+// are laid out back to back in id order, in_offset(g, nv) == nedges(g)
+int in_offset(graph_t g, int id)
+{
+	assert(g);
+	build_graph(g);
+	return g->in_off[id];
 }
 
-// return a list of node id(s) that has inlinks from @id
-int *nodes_from(graph_t g, int id, int *size)
+// raw csc arrays for kernels that walk many vertices at once:
+// the in-links of v are in_links(g)[in_offsets(g)[v] .. in_offsets(g)[v + 1])
+const int *in_offsets(graph_t g)
 {
 	assert(g);
-	int *list = malloc(g->ne * sizeof(int));
-	DUMP_ERR(list, "malloc failed");
-	*size = 0;
+	build_graph(g);
+	return g->in_off;
+}
 
-	for (int i = 0; i < g->ne; i++) {
-		if (g->edges[id][i] && i != id) {
-			list[(*size)++] = i;
-		}
-	}
+const int *in_links(graph_t g)
+{
+	assert(g);
+	build_graph(g);
+	return g->in_adj;
+}
 
-	// shrink size
-	if (*size) {
-		int *tmp = realloc(list, *size * sizeof(int));
-		DUMP_ERR(tmp, "realloc failed");
-		list = tmp;
-	}
+// raw csr arrays, laid out like the csc ones
+const int *out_offsets(graph_t g)
+{
+	assert(g);
+	build_graph(g);
+	return g->out_off;
+}
 
-	return list;
+const int *out_links(graph_t g)
+{
+	assert(g);
+	build_graph(g);
+	return g->out_adj;
 }
 
 void show_graph(graph_t g, int mode)
@@ -214,21 +409,26 @@ void show_graph(graph_t g, int mode)
 	if (g->nv == 0)
 		fprintf(stderr, "graph is empty\n");
 	else {
+		build_graph(g);
 		printf("graph has %d vertices:\n", g->nv);
 
 		for (int i = 0; i < g->nv; i++) {
+			int e = g->out_off[i];
 			if (mode == SHOW_MTRX) {
 				printf("%s ", id_to_name(g, i));
-				for (int j = 0; j < g->nv; j++)
-					printf("%d", g->edges[i][j]);
+				// row is sorted so walk it alongside @j
+				for (int j = 0; j < g->nv; j++) {
+					int has = e < g->out_off[i + 1] &&
+						g->out_adj[e] == j;
+					if (has) e++;
+					printf("%d", has);
+				}
 				putchar('\n');
 			} else if (mode == SHOW_INDENT) {
-				printf("Vertex: %s\n", g->vertex[i]);
+				printf("Vertex: %s\n", id_to_name(g, i));
 				printf("connects to\n");
-				for (int j = 0; j < g->nv; j++) {
-					if (g->edges[i][j])
-						printf("\t%s\n", g->vertex[j]);
-				}
+				for (; e < g->out_off[i + 1]; e++)
+					printf("\t%s\n", id_to_name(g, g->out_adj[e]));
 			}
 		}
 	}
@@ -237,31 +437,210 @@ void show_graph(graph_t g, int mode)
 char *id_to_name(graph_t g, int id)
 {
 	assert(g);
-	return g->vertex[id];
+	if (g->snap_names)
+		return (char *)g->snap_names + g->snap_noff[id];
+	return id_to_str(g->vertex, id);
+}
+
+// return id of vertex @name, -1 if it is not in the graph
+int name_to_id(graph_t g, char *name)
+{
+	return get_vertex_id(g, name);
 }
 
 static int get_vertex_id(graph_t g, char *name)
 {
 	assert(g);
-	for (int i = 0; i < g->nv; i++)
-		if (strcmp(name, g->vertex[i]) == 0) return i;
-	return -1;
+	if (g->vertex == NULL) intern_names(g);
+	return find_str(g->vertex, name);
 }
 
 static int add_vertex(graph_t g, char *name)
 {
 	assert(g);
 	assert(strlen(name) > 0);
-	char **tmp = realloc(g->vertex, (g->nv + 1) * sizeof(char *));
+	if (g->vertex == NULL) intern_names(g);
+	int id = intern_str(g->vertex, name);
+	g->nv = strtab_size(g->vertex);
+	return id;
+}
 
-	DUMP_ERR(tmp, "malloc failed");
+// a loaded graph only builds its name table once a name is looked up
+static void intern_names(graph_t g)
+{
+	g->vertex = new_strtab();
+	for (int i = 0; i < g->nv; i++)
+		intern_str(g->vertex, id_to_name(g, i));
+}
 
-	g->vertex = tmp;
-	// use malloc + strcpy instead of strdup since strdup
-	// is not in C standard library
-	g->vertex[g->nv] = malloc(strlen(name) + 1);
-	strcpy(g->vertex[g->nv], name);
-	g->nv++;
+// copy a loaded graph to the heap so it can be modified
+static void unmap_graph(graph_t g)
+{
+	assert(g && g->map);
+	if (g->vertex == NULL) intern_names(g);
+
+	int *out_off = malloc(((size_t)g->nv + 1) * sizeof(int));
+	int *in_off = malloc(((size_t)g->nv + 1) * sizeof(int));
+	int *out_adj = malloc(((size_t)g->ne + 1) * sizeof(int));
+	int *in_adj = malloc(((size_t)g->ne + 1) * sizeof(int));
+	DUMP_ERR(out_off, "malloc failed");
+	DUMP_ERR(in_off, "malloc failed");
+	DUMP_ERR(out_adj, "malloc failed");
+	DUMP_ERR(in_adj, "malloc failed");
+	memcpy(out_off, g->out_off, ((size_t)g->nv + 1) * sizeof(int));
+	memcpy(in_off, g->in_off, ((size_t)g->nv + 1) * sizeof(int));
+	memcpy(out_adj, g->out_adj, (size_t)g->ne * sizeof(int));
+	memcpy(in_adj, g->in_adj, (size_t)g->ne * sizeof(int));
+
+	munmap(g->map, g->map_len);
+	g->map = NULL;
+	g->map_len = 0;
+	g->snap_names = NULL;
+	g->snap_noff = NULL;
+	g->snap_stamp = NULL;
+	g->snap_nstamp = 0;
+	g->out_off = out_off;
+	g->in_off = in_off;
+	g->out_adj = out_adj;
+	g->in_adj = in_adj;
+}
+
+// fill @off with the byte offset of every snapshot section
+static void snap_layout(size_t nv, size_t ne, size_t names_len,
+			size_t nstamp, size_t *off)
+{
+	off[SEC_OUT_OFF] = sizeof(struct snap_header);
+	off[SEC_OUT_ADJ] = off[SEC_OUT_OFF] + (nv + 1) * sizeof(int32_t);
+	off[SEC_IN_OFF] = off[SEC_OUT_ADJ] + ne * sizeof(int32_t);
+	off[SEC_IN_ADJ] = off[SEC_IN_OFF] + (nv + 1) * sizeof(int32_t);
+	off[SEC_NAME_OFF] = off[SEC_IN_ADJ] + ne * sizeof(int32_t);
+	// align name offsets to 8 bytes
+	off[SEC_NAME_OFF] = (off[SEC_NAME_OFF] + 7) & ~(size_t)7;
+	off[SEC_NAMES] = off[SEC_NAME_OFF] + nv * sizeof(uint64_t);
+	off[SEC_STAMP] = (off[SEC_NAMES] + names_len + 7) & ~(size_t)7;
+	off[SEC_END] = off[SEC_STAMP] + nstamp * sizeof(uint64_t);
+}
+
+/*
+ * save_graph - write @g to a binary snapshot at @path
+ * @stamp: @nstamp values describing what @g was built from, such as the
+ *	   sizes and times of its source files, handed back by graph_stamps
+ *
+ * The snapshot holds the compressed arrays and vertex names exactly as
+ * load_graph serves them, so loading it costs one mmap.
+ */
+void save_graph(graph_t g, char *path, const uint64_t *stamp, int nstamp)
+{
+	assert(g);
+	build_graph(g);
+
+	FILE *fp = fopen(path, "wb");
+	DUMP_ERR(fp, "Failed to open file");
+
+	uint64_t *noff = malloc(((size_t)g->nv + 1) * sizeof(uint64_t));
+	DUMP_ERR(noff, "malloc failed");
+	uint64_t names_len = 0;
+	for (int i = 0; i < g->nv; i++) {
+		noff[i] = names_len;
+		names_len += strlen(id_to_name(g, i)) + 1;
+	}
+
+	struct snap_header h;
+	memset(&h, 0, sizeof(h));
+	memcpy(h.magic, SNAP_MAGIC, sizeof(SNAP_MAGIC));
+	h.version = SNAP_VERSION;
+	h.nv = g->nv;
+	h.ne = g->ne;
+	h.int_size = sizeof(int);
+	h.names_len = names_len;
+	h.nstamp = nstamp;
+
+	size_t off[SEC_END + 1];
+	snap_layout(g->nv, g->ne, names_len, nstamp, off);
+	static const char zero[8];
+
+	int ok = fwrite(&h, sizeof(h), 1, fp) == 1;
+	ok = ok && fwrite(g->out_off, sizeof(int), g->nv + 1, fp) == (size_t)g->nv + 1;
+	ok = ok && fwrite(g->out_adj, sizeof(int), g->ne, fp) == (size_t)g->ne;
+	ok = ok && fwrite(g->in_off, sizeof(int), g->nv + 1, fp) == (size_t)g->nv + 1;
+	ok = ok && fwrite(g->in_adj, sizeof(int), g->ne, fp) == (size_t)g->ne;
+	const size_t pad = off[SEC_NAME_OFF] - (off[SEC_IN_ADJ] + g->ne * sizeof(int));
+	ok = ok && fwrite(zero, 1, pad, fp) == pad;
+	ok = ok && fwrite(noff, sizeof(uint64_t), g->nv, fp) == (size_t)g->nv;
+	for (int i = 0; ok && i < g->nv; i++) {
+		const char *name = id_to_name(g, i);
+		ok = fwrite(name, 1, strlen(name) + 1, fp) == strlen(name) + 1;
+	}
+	const size_t pad2 = off[SEC_STAMP] - (off[SEC_NAMES] + names_len);
+	ok = ok && fwrite(zero, 1, pad2, fp) == pad2;
+	ok = ok && fwrite(stamp, sizeof(uint64_t), nstamp, fp) == (size_t)nstamp;
+	free(noff);
+
+	if (fclose(fp) != 0 || !ok) {
+		perror("Failed to write graph snapshot");
+		exit(EXIT_FAILURE);
+	}
+}
 
-	return g->nv - 1;
+/*
+ * load_graph - map a snapshot written by save_graph
+ *
+ * nodes_to, nodes_from and the raw csr/csc accessors return pointers into
+ * the mapping, nothing is copied. Returns NULL if @path cannot be opened
+ * or is not a valid snapshot, so the caller can fall back to building the
+ * graph from scratch.
+ */
+graph_t load_graph(char *path)
+{
+	int fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return NULL;
+
+	struct stat st;
+	if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(struct snap_header)) {
+		close(fd);
+		return NULL;
+	}
+	void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED)
+		return NULL;
+
+	const struct snap_header *h = map;
+	size_t off[SEC_END + 1];
+	snap_layout(h->nv, h->ne, h->names_len, h->nstamp, off);
+	if (memcmp(h->magic, SNAP_MAGIC, sizeof(SNAP_MAGIC)) != 0 ||
+	    h->version != SNAP_VERSION || h->int_size != sizeof(int) ||
+	    off[SEC_END] != (size_t)st.st_size) {
+		fprintf(stderr, "%s: not a graph snapshot\n", path);
+		munmap(map, st.st_size);
+		return NULL;
+	}
+
+	graph_t g = new_graph();
+	free_strtab(g->vertex);
+	g->vertex = NULL;
+	g->nv = g->nbuilt = h->nv;
+	g->ne = h->ne;
+	g->map = map;
+	g->map_len = st.st_size;
+	// the mapping is read only, nothing writes through these
+	g->out_off = (int *)((char *)map + off[SEC_OUT_OFF]);
+	g->out_adj = (int *)((char *)map + off[SEC_OUT_ADJ]);
+	g->in_off = (int *)((char *)map + off[SEC_IN_OFF]);
+	g->in_adj = (int *)((char *)map + off[SEC_IN_ADJ]);
+	g->snap_noff = (const uint64_t *)((char *)map + off[SEC_NAME_OFF]);
+	g->snap_names = (const char *)map + off[SEC_NAMES];
+	g->snap_stamp = (const uint64_t *)((char *)map + off[SEC_STAMP]);
+	g->snap_nstamp = h->nstamp;
+
+	return g;
+}
+
+// stamps saved with the snapshot @g was loaded from, NULL if it was not
+const uint64_t *graph_stamps(graph_t g, int *n)
+{
+	assert(g);
+	*n = g->snap_nstamp;
+	return g->snap_stamp;
 }
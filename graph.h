@@ -5,6 +5,8 @@
 #ifndef GRAPH_H
 #define GRAPH_H
 
+#include <stdint.h>
+
 // show_graph mode constants
 #define SHOW_INDENT 0
 #define SHOW_MTRX 1
@@ -17,12 +19,22 @@ graph_t new_graph(void);
 void free_graph(graph_t);
 int add_edge(graph_t ,char *, char *);
 int nvertices(graph_t);
+int nedges(graph_t);
 int outdegree(graph_t, int);
 int indegree(graph_t, int);
-int *nodes_to(graph_t, int, int *);
-int *nodes_from(graph_t, int, int *);
+const int *nodes_to(graph_t, int, int *);
+const int *nodes_from(graph_t, int, int *);
+int in_offset(graph_t, int);
+const int *in_offsets(graph_t);
+const int *in_links(graph_t);
+const int *out_offsets(graph_t);
+const int *out_links(graph_t);
+int name_to_id(graph_t, char *);
 char *id_to_name(graph_t, int);
 int is_connected(graph_t, char *, char *);
 void show_graph(graph_t, int);
+void save_graph(graph_t, char *, const uint64_t *, int);
+graph_t load_graph(char *);
+const uint64_t *graph_stamps(graph_t, int *);
 
 #endif
@@ -0,0 +1,98 @@
+// parse collection pages on a thread pool
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include <stdatomic.h>
+
+#include "ingest.h"
+#include "pool.h"
+
+// macro for dumping error messages
+#ifndef DUMP_ERR
+#define DUMP_ERR(ptr, str)				\
+	if (ptr == NULL) {				\
+		perror(str);				\
+		exit(EXIT_FAILURE);			\
+	}
+#endif
+
+// number of pages parsed before they are handed to the caller, bounds
+// the number of files mapped at once
+#define WINDOW 1024
+
+// one window of pages, shared by the threads parsing it
+struct window {
+	handle_t cltn;
+	char *start_tag;
+	char *end_tag;
+	int norm;
+	// @lo, @hi - pages [lo, hi) of the collection
+	// @next - next page to hand out, relative to @lo
+	int lo;
+	int hi;
+	atomic_int next;
+	handle_t *pages;
+};
+
+static void parse_task(void *, int, int);
+
+// threads take pages one at a time, so slow files do not hold up a
+// whole slice of the window
+static void parse_task(void *arg, int id, int n)
+{
+	struct window *w = arg;
+	int i;
+
+	while ((i = w->lo + atomic_fetch_add(&w->next, 1)) < w->hi) {
+		// e.g. url1234.txt
+		char *url = getbuf(w->cltn, i);
+		char *fname = malloc(strlen(url) + 5);
+		DUMP_ERR(fname, "malloc failed");
+		sprintf(fname, "%s.txt", url);
+
+		handle_t hd = parse_url(fname, w->start_tag, w->end_tag);
+		if (w->norm) normalise(hd);
+		w->pages[i - w->lo] = hd;
+		free(fname);
+	}
+}
+
+/*
+ * for_each_page - parse every page of @cltn and pass it to @fn
+ *
+ * Only the section between @start_tag and @end_tag is tokenized, and
+ * normalised as well if @norm is set. @fn may keep nothing from @page
+ * after it returns, the handle is freed right away.
+ */
+void for_each_page(handle_t cltn, char *start_tag, char *end_tag,
+		   int norm, int nthreads, page_fn fn, void *arg)
+{
+	assert(cltn && fn);
+
+	pool_t pool = new_pool(nthreads);
+	struct window w = {
+		.cltn = cltn,
+		.start_tag = start_tag,
+		.end_tag = end_tag,
+		.norm = norm,
+	};
+	w.pages = malloc(WINDOW * sizeof(handle_t));
+	DUMP_ERR(w.pages, "malloc failed");
+
+	for (w.lo = 0; w.lo < handle_size(cltn); w.lo = w.hi) {
+		w.hi = w.lo + WINDOW;
+		if (w.hi > handle_size(cltn)) w.hi = handle_size(cltn);
+		atomic_store(&w.next, 0);
+		pool_run(pool, parse_task, &w);
+
+		for (int i = w.lo; i < w.hi; i++) {
+			fn(arg, getbuf(cltn, i), w.pages[i - w.lo]);
+			free_handle(w.pages[i - w.lo]);
+		}
+	}
+
+	free(w.pages);
+	free_pool(pool);
+}
@@ -0,0 +1,19 @@
+// ingest.h ... Interface to parallel parsing of the pages of a collection
+//
+// Pages are parsed by a pool of threads, a window at a time, and handed
+// to the caller strictly in collection order, so whatever the caller
+// builds from them is identical to a sequential run.
+
+#ifndef INGEST_H
+#define INGEST_H
+
+#include "parser.h"
+
+// called once per page, in collection order, on the calling thread
+// @url - url of the page, @page - tokens of the requested section
+typedef void (*page_fn)(void *arg, char *url, handle_t page);
+
+void for_each_page(handle_t cltn, char *start_tag, char *end_tag,
+		   int norm, int nthreads, page_fn fn, void *arg);
+
+#endif
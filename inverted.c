@@ -1,40 +1,90 @@
+// getopt is POSIX
+#define _POSIX_C_SOURCE 200809L
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
+#include <getopt.h>
 
 #include "parser.h"
 #include "invindex.h"
+#include "ingest.h"
+#include "stats.h"
 
-static invindex_t get_invindex(handle_t);
+static invindex_t get_invindex(handle_t, doctab_t, int);
+static void add_words(void *, char *, handle_t);
 
-int main(void)
+int main(int argc, char **argv)
 {
+	int nthreads = 1;
+	// --stats[=file], dumps timings as JSON to @stats_path or stderr
+	static const struct option longopts[] = {
+		{ "stats", optional_argument, NULL, 'S' },
+		{ NULL, 0, NULL, 0 }
+	};
+	char *stats_path = NULL;
+	int c;
+
+	while ((c = getopt_long(argc, argv, "t:", longopts, NULL)) != -1) {
+		switch (c) {
+		case 'S':
+			stats_enable();
+			stats_path = optarg;
+			break;
+		case 't':
+			nthreads = atoi(optarg);
+			break;
+		default:
+			argc = 0;
+		}
+	}
+
+	if (argc - optind != 0 || nthreads < 1) {
+		fprintf(stderr, "Usage: %s [-t threads] [--stats[=file]]\n",
+			argv[0]);
+		return EXIT_FAILURE;
+	}
+
 	handle_t cltn = parse("collection.txt");
+	doctab_t docs = new_doctab(cltn);
 
-	invindex_t index = get_invindex(cltn);
+	double t = stats_start();
+	invindex_t index = get_invindex(cltn, docs, nthreads);
+	stats_stop("get_invindex", t);
+	t = stats_start();
 	output_index(index, "invertedIndex.txt");
+	stats_stop("output_index", t);
+	t = stats_start();
+	output_postings(index, "invertedIndex.bin");
+	stats_stop("output_postings", t);
 	//show_index(index);
 	free_index(index);
+	free_doctab(docs);
 	free_handle(cltn);
+	if (stats_enabled())
+		stats_save(stats_path);
 }
 
-static invindex_t get_invindex(handle_t cltn)
+// index every word of a page under @url
+static void add_words(void *arg, char *url, handle_t page)
 {
-	invindex_t index = newindex();
+	invindex_t index = arg;
+	set_doc_len(index, url, handle_size(page));
+	stats_count("pages", 1);
+	stats_count("tokens", handle_size(page));
+	for (int j = 0; j < handle_size(page); j++)
+		add_entry(index, getbuf(page, j), url);
+}
 
-	for (int i = 0; i < handle_size(cltn); i++) {
-		char *fname = malloc(strlen(getbuf(cltn, i)) + 4);
-		sprintf(fname, "%s.txt", getbuf(cltn, i));
+static invindex_t get_invindex(handle_t cltn, doctab_t docs, int nthreads)
+{
+	invindex_t index = newindex(docs, NULL);
 
-		handle_t hd = parse_url(fname, "#start Section-2", "#end Section-2");
-		// normalise all the words in @hd
-		normalise(hd);
-		for (int j = 0; j < handle_size(hd); j++) {
-			add_entry(index, getbuf(hd, j), getbuf(cltn, i));
-		}
-		free_handle(hd);
-		free(fname);
-	}
+	// pages are parsed and normalised on @nthreads threads but indexed
+	// in collection order
+	for_each_page(cltn, "#start Section-2", "#end Section-2", 1,
+		      nthreads, add_words, index);
 
 	return index;
 }
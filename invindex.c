@@ -1,9 +1,20 @@
+// mmap, open and fstat are POSIX
+#define _POSIX_C_SOURCE 200809L
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <assert.h>
 #include <string.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #include "invindex.h"
+#include "strtab.h"
+#include "varint.h"
+#include "arena.h"
 
 // macro for dumping error messages
 #ifndef DUMP_ERR
@@ -17,80 +28,137 @@
 // default array size for invindex_t tokens
 #define DEFAULT_SIZE 30
 
+// binary index, see output_postings
+#define INDEX_MAGIC "PRINDEX"
+#define INDEX_VERSION 3
+// words per dictionary block, see output_postings
+#define DICT_BLOCK 16
+
+struct idx_header {
+	char magic[8];
+	uint32_t version;
+	uint32_t nwords;
+	uint32_t ndocs;
+	uint32_t max_word;	// bytes of the longest word
+	uint64_t dict_len;	// bytes of dict
+	uint64_t docs_len;	// bytes of docs
+	uint64_t blob_len;	// bytes of blob
+};
+
+// where a dictionary block starts in dict and its first posting list
+// in blob
+struct dict_block {
+	uint64_t dict;
+	uint64_t blob;
+};
+
+// posting list of one word
 struct _invurl {
-	char *word;		// stores token, eg, "design"/"mars"
-	char **urls;		// stores url
+	unsigned *docs;		// doc ids, append only until finalize
+	unsigned *tf;		// occurrences of the word in each of @docs
 	int count;		// stores number of appearence of word
 	int maxurl;		// maximum number of urls
+	char **urls;		// names of @docs, built by finalize
 };
 
-// wrapper of an array of invurl_t
+/*
+ * Words are interned into a hash table and urls are replaced by their
+ * doc id, so adding an entry is O(1): the word's posting list gets the
+ * doc id appended, or the count of its last doc bumped. finalize sorts
+ * every posting list, merging the counts of repeated docs, and the word
+ * list once, the first time the index is read after a change. Doc ids
+ * follow url order, so sorted postings list urls alphabetically as
+ * invertedIndex.txt always did.
+ *
+ * Term counts and document lengths are what tf-idf needs; the document
+ * frequency of a word is the length of its posting list.
+ */
 struct _invindex {
-	invurl_t *tokens;	// stores an array of tokens
+	doctab_t docs;		// doc id <-> url, not owned
+	strtab_t words;		// word -> token id
+	invurl_t *tokens;	// posting lists by token id
 	int size;		// size of the above array
 	int max_size;		// maximum size of *tokens
+	int *order;		// token ids sorted by word, built by finalize
+	int final;		// set while postings are sorted
+	unsigned *doclen;	// words in each doc, NULL until set_doc_len
+	// token structs, url lists and decoded postings; only the posting
+	// lists that grow while indexing are malloc'd
+	arena_t mem;
+	int own_mem;		// @mem is freed with the index
+	// binary index mapped by map_index, NULL otherwise; @tokens then
+	// caches the posting lists decoded so far
+	void *map;
+	size_t map_len;
+	const struct idx_header *hdr;
+	const struct dict_block *block;
+	const uint64_t *doc_off;
+	const uint32_t *doc_len;
+	const unsigned char *dict;
+	const char *docstr;
+	const unsigned char *blob;
+	char *term;		// max_word + 1 bytes, words of dict go here
 };
 
-static void add_url(invurl_t tok, char *url);
-static void sort_url(invurl_t u);
-static void sort_tok(invindex_t ind);
+// token id with its word, for sorting
+struct named {
+	char *name;
+	int id;
+};
+
+// doc id with its term count, for sorting
+struct posting {
+	unsigned doc;
+	unsigned tf;
+};
+
+static void add_url(invurl_t tok, unsigned doc);
 static void add_urls_size(invurl_t u);
 static void add_tokens_size(invindex_t ind);
-static invurl_t *search_tok(invindex_t ind, char *word);
+static void finalize(invindex_t ind);
+
+static invurl_t new_token(invindex_t ind, char *word);
+static invurl_t map_token(invindex_t ind, char *word);
+static invurl_t find_token(invindex_t ind, char *word);
 
 /*
  * newindex - create an invindex adt
  * invindex_t is typedef'd in invindex.h
- * The struct wraps an array of invurl_t and the @size and @max_size of
- * the array
+ * urls are mapped to doc ids through @docs, which must outlive the index
+ * nodes are allocated from @mem, or from an arena of its own if NULL
  */
-invindex_t newindex(void) {
+invindex_t newindex(doctab_t docs, arena_t mem) {
 	invindex_t new = malloc(sizeof(struct _invindex));
 	DUMP_ERR(new, "malloc failed");
 
+	new->own_mem = mem == NULL;
+	new->mem = mem ? mem : new_arena(0);
+	new->docs = docs;
+	new->words = new_strtab();
 	new->size = 0;
 	new->max_size = DEFAULT_SIZE;
 	new->tokens = malloc(new->max_size * sizeof(invurl_t));
 	DUMP_ERR(new->tokens, "malloc failed");
-
-	for (int i = 0; i < new->max_size; i++) {
-		// init structs
-		new->tokens[i] = malloc(sizeof(struct _invurl));
-		new->tokens[i]->word = NULL;
-		new->tokens[i]->urls = NULL;
-		new->tokens[i]->count = 0;
-		new->tokens[i]->maxurl = 0;
-		add_urls_size(new->tokens[i]);
-	}
+	new->order = NULL;
+	new->final = 1;
+	new->doclen = NULL;
+	new->map = NULL;
+	new->map_len = 0;
 
 	return new;
 }
 
 //  internal string comparison function
-int _url_cmp(const void *a, const void *b)
+int _named_cmp(const void *a, const void *b)
 {
-	return strcmp(*(char **)a, *(char **)b);
+	return strcmp(((struct named *)a)->name, ((struct named *)b)->name);
 }
 
-// wrapper for qsort
-// sorts only u->urls
-static void sort_url(invurl_t u)
+int _posting_cmp(const void *a, const void *b)
 {
-	qsort(u->urls, u->count, sizeof(char *), _url_cmp);
-}
-
-int _tok_cmp(const void *a, const void *b)
-{
-	invurl_t *ia = (invurl_t *)a;
-	invurl_t *ib = (invurl_t *)b;
-	return strcmp((*ia)->word, (*ib)->word);
-}
-
-// wrapper for qsort
-// sorts only invindex_t tokens
-static void sort_tok(invindex_t ind)
-{
-	qsort(ind->tokens, ind->size, sizeof(invurl_t), _tok_cmp);
+	unsigned ia = ((struct posting *)a)->doc;
+	unsigned ib = ((struct posting *)b)->doc;
+	return (ia > ib) - (ia < ib);
 }
 
 /* add_urls_size - realloc url array
@@ -103,85 +171,162 @@ static void add_urls_size(invurl_t u)
 {
 	assert(u);
 
-	const int new_size = u->count == 0 ? 5 : (double)u->count * 1.25;
-	char **tmp = realloc(u->urls, new_size * sizeof(char *));
+	const int new_size = u->count < 4 ? 5 : (double)u->count * 1.25;
+	unsigned *tmp = realloc(u->docs, new_size * sizeof(unsigned));
 	DUMP_ERR(tmp, "realloc failed");
+	u->docs = tmp;
+	tmp = realloc(u->tf, new_size * sizeof(unsigned));
+	DUMP_ERR(tmp, "realloc failed");
+	u->tf = tmp;
 
-	u->urls = tmp;
 	u->maxurl = new_size;
-	for (int i = u->count; i < u->maxurl; i++)
-		u->urls[i] = NULL;
 }
 
-static void add_url(invurl_t tok, char *url)
+static void add_url(invurl_t tok, unsigned doc)
+{
+	assert(tok);
+
+	// pages are indexed one at a time, so repeated words of a page are
+	// counted here; anything else is merged by finalize
+	if (tok->count > 0 && tok->docs[tok->count - 1] == doc) {
+		tok->tf[tok->count - 1]++;
+		return;
+	}
+	if (tok->count >= tok->maxurl) add_urls_size(tok);
+	tok->docs[tok->count] = doc;
+	tok->tf[tok->count++] = 1;
+}
+
+// return the posting list of @word, creating it if needed
+static invurl_t new_token(invindex_t ind, char *word)
 {
-	assert(tok && url);
-
-	// search for duplicated urls
-	sort_url(tok);
-	char **result = bsearch(&url, tok->urls, tok->count, \
-				sizeof(char *), _url_cmp);
-	if (!result) {
-		tok->urls[tok->count] = malloc(strlen(url) + 1);
-		strcpy(tok->urls[tok->count], url);
-		tok->count++;
-		sort_url(tok);
-		if (tok->count >= tok->maxurl) add_urls_size(tok);
+	int id = intern_str(ind->words, word);
+	if (id == ind->size) {
+		// add to a new token
+		if (ind->size >= ind->max_size) add_tokens_size(ind);
+		invurl_t tok = arena_alloc(ind->mem, sizeof(struct _invurl));
+		tok->docs = NULL;
+		tok->tf = NULL;
+		tok->count = tok->maxurl = 0;
+		tok->urls = NULL;
+		ind->tokens[ind->size++] = tok;
 	}
+	return ind->tokens[id];
 }
 
 // insert an entry into the index
+// urls that are not in the collection are ignored
 void add_entry(invindex_t ind, char *word, char *url)
 {
 	assert(ind);
 	assert(word && url);
+	// a mapped index is read only
+	assert(!ind->map);
 
-	invurl_t *tok = search_tok(ind, word);
-	// found
-	if (tok) {
-		add_url(*tok, url);
-	} else {
-		// add to a new token
-		ind->tokens[ind->size]->word = malloc(strlen(word) + 1);
-		strcpy(ind->tokens[ind->size]->word, word);
-		add_url(ind->tokens[ind->size], url);
-		ind->size++;
-		// sort before leaving the function
-		sort_tok(ind);
-		if (ind->size >= ind->max_size) add_tokens_size(ind);
+	int doc = doc_id(ind->docs, url);
+	if (doc < 0) return;
+	add_url(new_token(ind, word), doc);
+	ind->final = 0;
+}
+
+// record the number of words of @url, for tf-idf
+void set_doc_len(invindex_t ind, char *url, int len)
+{
+	assert(ind && url);
+	assert(!ind->map);
+
+	int doc = doc_id(ind->docs, url);
+	if (doc < 0) return;
+	if (!ind->doclen) {
+		ind->doclen = calloc(ndocs(ind->docs) + 1, sizeof(unsigned));
+		DUMP_ERR(ind->doclen, "calloc failed");
 	}
+	ind->doclen[doc] = len;
 }
 
 // increase invindex_t->tokens' size by a quarter
 static void add_tokens_size(invindex_t ind)
 {
-	const int new_size = (double)ind->size * 1.25;
+	const int new_size = (double)ind->max_size * 1.25;
 	invurl_t *tmp = realloc(ind->tokens, new_size * sizeof(invurl_t));
 	DUMP_ERR(tmp, "realloc failed");
 
 	ind->tokens = tmp;
 	ind->max_size = new_size;
+}
 
-	for (int i = ind->size; i < new_size; i++) {
-		ind->tokens[i] = malloc(sizeof(struct _invurl));
-		// init struct
-		ind->tokens[i]->word = NULL;
-		ind->tokens[i]->urls = NULL;
-		ind->tokens[i]->count = 0;
-		ind->tokens[i]->maxurl = 0;
-		add_urls_size(ind->tokens[i]);
+/*
+ * finalize - sort words and posting lists
+ *
+ * Doc ids follow url order, so posting lists sort as plain integers.
+ */
+static void finalize(invindex_t ind)
+{
+	if (ind->final) return;
+
+	struct posting *post = NULL;
+	int max_post = 0;
+	for (int t = 0; t < ind->size; t++) {
+		invurl_t u = ind->tokens[t];
+		if (u->count > max_post) {
+			max_post = u->count;
+			free(post);
+			post = malloc(max_post * sizeof(struct posting));
+			DUMP_ERR(post, "malloc failed");
+		}
+		for (int j = 0; j < u->count; j++) {
+			post[j].doc = u->docs[j];
+			post[j].tf = u->tf[j];
+		}
+		qsort(post, u->count, sizeof(struct posting), _posting_cmp);
+
+		int n = 0;
+		for (int j = 0; j < u->count; j++) {
+			if (n > 0 && post[j].doc == u->docs[n - 1]) {
+				u->tf[n - 1] += post[j].tf;
+			} else {
+				u->docs[n] = post[j].doc;
+				u->tf[n++] = post[j].tf;
+			}
+		}
+		u->count = n;
+
+		// a list from an earlier finalize stays in the arena
+		u->urls = arena_alloc(ind->mem, (n + 1) * sizeof(char *));
+		for (int j = 0; j < n; j++)
+			u->urls[j] = doc_url(ind->docs, u->docs[j]);
 	}
+	free(post);
+
+	// words in alphabetical order
+	struct named *words = malloc((ind->size + 1) * sizeof(struct named));
+	DUMP_ERR(words, "malloc failed");
+	for (int t = 0; t < ind->size; t++) {
+		words[t].name = id_to_str(ind->words, t);
+		words[t].id = t;
+	}
+	qsort(words, ind->size, sizeof(struct named), _named_cmp);
+	free(ind->order);
+	ind->order = malloc((ind->size + 1) * sizeof(int));
+	DUMP_ERR(ind->order, "malloc failed");
+	for (int t = 0; t < ind->size; t++)
+		ind->order[t] = words[t].id;
+
+	free(words);
+	ind->final = 1;
 }
 
 // print the structure of invindex_t
 // for debugging
 void show_index(invindex_t ind)
 {
-	assert(ind);
+	assert(ind && !ind->map);
+	finalize(ind);
 	for (int i = 0; i < ind->size; i++) {
-		printf("%s: ", ind->tokens[i]->word);
-		for (int j = 0; j < ind->tokens[i]->count; j++)
-			printf("%s ", ind->tokens[i]->urls[j]);
+		const int t = ind->order[i];
+		printf("%s: ", id_to_str(ind->words, t));
+		for (int j = 0; j < ind->tokens[t]->count; j++)
+			printf("%s ", ind->tokens[t]->urls[j]);
 		putchar('\n');
 	}
 }
@@ -190,46 +335,311 @@ void show_index(invindex_t ind)
 void free_index(invindex_t ind)
 {
 	assert(ind);
-	for (int i = 0; i < ind->max_size; i++) {
-		free(ind->tokens[i]->word);
-		for (int j = 0; j < ind->tokens[i]->maxurl; j++)
-			free(ind->tokens[i]->urls[j]);
-		free(ind->tokens[i]->urls);
-		free(ind->tokens[i]);
+	// decoded postings of a mapped index are in the arena
+	for (int i = 0; !ind->map && i < ind->size; i++) {
+		free(ind->tokens[i]->docs);
+		free(ind->tokens[i]->tf);
 	}
+	if (ind->own_mem) free_arena(ind->mem);
+	free_strtab(ind->words);
+	if (ind->map) munmap(ind->map, ind->map_len);
+	free(ind->order);
+	free(ind->doclen);
 	free(ind->tokens);
 	free(ind);
 }
 
 void output_index(invindex_t ind, char *path)
 {
-	assert(ind);
+	assert(ind && !ind->map);
+	finalize(ind);
 	FILE *fp = fopen(path, "w");
 
 	for (int i = 0; i < ind->size; i++) {
-		fprintf(fp, "%s ", ind->tokens[i]->word);
-		for (int j = 0; j < ind->tokens[i]->count; j++)
-			fprintf(fp, "%s ", ind->tokens[i]->urls[j]);
+		const int t = ind->order[i];
+		fprintf(fp, "%s ", id_to_str(ind->words, t));
+		for (int j = 0; j < ind->tokens[t]->count; j++)
+			fprintf(fp, "%s ", ind->tokens[t]->urls[j]);
 		fputc('\n', fp);
 	}
 	fclose(fp);
 }
 
+// byte offset of each section, the last entry is the file size
+enum { SEC_BLOCK, SEC_DOC_OFF, SEC_DOC_LEN, SEC_DICT, SEC_DOCS, SEC_BLOB,
+       SEC_END };
+
+static size_t dict_blocks(const struct idx_header *h)
+{
+	return ((size_t)h->nwords + DICT_BLOCK - 1) / DICT_BLOCK;
+}
+
+// fill @off with the byte offset of every section of a binary index
+static void index_layout(const struct idx_header *h, size_t *off)
+{
+	off[SEC_BLOCK] = sizeof(struct idx_header);
+	off[SEC_DOC_OFF] = off[SEC_BLOCK] +
+		dict_blocks(h) * sizeof(struct dict_block);
+	off[SEC_DOC_LEN] = off[SEC_DOC_OFF] + h->ndocs * sizeof(uint64_t);
+	off[SEC_DICT] = off[SEC_DOC_LEN] + h->ndocs * sizeof(uint32_t);
+	off[SEC_DOCS] = off[SEC_DICT] + h->dict_len;
+	off[SEC_BLOB] = off[SEC_DOCS] + h->docs_len;
+	off[SEC_END] = off[SEC_BLOB] + h->blob_len;
+}
+
+// write the dict entry of @word, which follows @prev in its block;
+// return the number of bytes written
+static size_t put_entry(unsigned char *out, const char *prev,
+			const char *word, unsigned count, unsigned len)
+{
+	unsigned pre = 0;
+	while (prev[pre] && prev[pre] == word[pre])
+		pre++;
+	const unsigned suf = strlen(word + pre);
+	size_t n = put_varint(out, pre);
+	n += put_varint(out + n, suf);
+	memcpy(out + n, word + pre, suf);
+	n += suf;
+	n += put_varint(out + n, count);
+	n += put_varint(out + n, len);
+	return n;
+}
+
+// read the dict entry at @in; @term holds the word before it in its
+// block and is overwritten with its own. Return the number of bytes read
+static size_t get_entry(const unsigned char *in, char *term,
+			unsigned *count, unsigned *len)
+{
+	unsigned pre, suf;
+	size_t n = get_varint(in, &pre);
+	n += get_varint(in + n, &suf);
+	memcpy(term + pre, in + n, suf);
+	term[pre + suf] = '\0';
+	n += suf;
+	n += get_varint(in + n, count);
+	n += get_varint(in + n, len);
+	return n;
+}
+
+/*
+ * output_postings - write the index in binary
+ *
+ * The file holds, after a header:
+ *
+ *	block[nwords / DICT_BLOCK]	struct dict_block, where each block of
+ *					DICT_BLOCK words starts
+ *	doc_off[ndocs]			uint64, offset of each url in docs
+ *	doc_len[ndocs]			uint32, number of words of each doc
+ *	dict				per word, in alphabetical order: the
+ *					bytes it shares with the word before
+ *					it in its block, the length and bytes
+ *					of the rest, its number of docs and
+ *					the bytes of its posting list, all
+ *					varints
+ *	docs				'\0' separated urls, in doc id order
+ *	blob				per word, doc ids delta/varint encoded
+ *					followed by their term counts as varints
+ *
+ * Every block starts with a whole word, so map_index can binary search
+ * the first words of the blocks and scan one block without reading the
+ * rest. Sorted words share long prefixes, which front coding drops.
+ */
+void output_postings(invindex_t ind, char *path)
+{
+	assert(ind && !ind->map);
+	finalize(ind);
+	FILE *fp = fopen(path, "wb");
+	DUMP_ERR(fp, "Cannot open file");
+
+	const int nw = ind->size;
+	const int nd = ndocs(ind->docs);
+	const int nb = (nw + DICT_BLOCK - 1) / DICT_BLOCK;
+
+	// room for the longest possible entries and posting lists
+	size_t dict_max = 0;
+	size_t blob_max = 0;
+	for (int i = 0; i < nw; i++) {
+		dict_max += strlen(id_to_str(ind->words, i)) + 4 * VARINT_MAX;
+		blob_max += (size_t)ind->tokens[i]->count * 2 * VARINT_MAX;
+	}
+	struct dict_block *block = malloc((nb + 1) * sizeof(struct dict_block));
+	unsigned char *dict = malloc(dict_max + 1);
+	unsigned char *blob = malloc(blob_max + 1);
+	uint64_t *doc_off = malloc((nd + 1) * sizeof(uint64_t));
+	uint32_t *len = calloc(nd + 1, sizeof(uint32_t));
+	DUMP_ERR(block, "malloc failed");
+	DUMP_ERR(dict, "malloc failed");
+	DUMP_ERR(blob, "malloc failed");
+	DUMP_ERR(doc_off, "malloc failed");
+	DUMP_ERR(len, "calloc failed");
+
+	struct idx_header h;
+	memset(&h, 0, sizeof(h));
+	memcpy(h.magic, INDEX_MAGIC, sizeof(INDEX_MAGIC));
+	h.version = INDEX_VERSION;
+	h.nwords = nw;
+	h.ndocs = nd;
+
+	const char *prev = "";
+	for (int i = 0; i < nw; i++) {
+		const invurl_t u = ind->tokens[ind->order[i]];
+		const char *word = id_to_str(ind->words, ind->order[i]);
+		if (i % DICT_BLOCK == 0) {
+			block[i / DICT_BLOCK].dict = h.dict_len;
+			block[i / DICT_BLOCK].blob = h.blob_len;
+			prev = "";
+		}
+		size_t n = encode_deltas(u->docs, u->count, blob + h.blob_len);
+		n += encode_varints(u->tf, u->count, blob + h.blob_len + n);
+		h.blob_len += n;
+		h.dict_len += put_entry(dict + h.dict_len, prev, word, u->count, n);
+		if (strlen(word) > h.max_word) h.max_word = strlen(word);
+		prev = word;
+	}
+	for (int d = 0; d < nd; d++) {
+		doc_off[d] = h.docs_len;
+		h.docs_len += strlen(doc_url(ind->docs, d)) + 1;
+		if (ind->doclen) len[d] = ind->doclen[d];
+	}
+
+	int ok = fwrite(&h, sizeof(h), 1, fp) == 1;
+	ok = ok && fwrite(block, sizeof(struct dict_block), nb, fp) == (size_t)nb;
+	ok = ok && fwrite(doc_off, sizeof(uint64_t), nd, fp) == (size_t)nd;
+	ok = ok && fwrite(len, sizeof(uint32_t), nd, fp) == (size_t)nd;
+	ok = ok && fwrite(dict, 1, h.dict_len, fp) == h.dict_len;
+	for (int d = 0; ok && d < nd; d++) {
+		const char *url = doc_url(ind->docs, d);
+		ok = fwrite(url, 1, strlen(url) + 1, fp) == strlen(url) + 1;
+	}
+	ok = ok && fwrite(blob, 1, h.blob_len, fp) == h.blob_len;
+	free(block);
+	free(dict);
+	free(blob);
+	free(doc_off);
+	free(len);
+
+	if (fclose(fp) != 0 || !ok) {
+		perror("Failed to write postings");
+		exit(EXIT_FAILURE);
+	}
+}
+
+/*
+ * map_index - map a binary index written by output_postings
+ *
+ * Nothing is read up front: docs_for and url_for binary search the
+ * word dictionary and decode just the posting lists they are asked for,
+ * which are then cached. Returns NULL if @path cannot be opened or is
+ * not a binary index, so callers can fall back to read_index.
+ */
+invindex_t map_index(char *path, arena_t mem)
+{
+	int fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return NULL;
+
+	struct stat st;
+	if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(struct idx_header)) {
+		close(fd);
+		return NULL;
+	}
+	void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED)
+		return NULL;
+
+	const struct idx_header *h = map;
+	size_t off[SEC_END + 1];
+	index_layout(h, off);
+	if (memcmp(h->magic, INDEX_MAGIC, sizeof(INDEX_MAGIC)) != 0 ||
+	    h->version != INDEX_VERSION || off[SEC_END] != (size_t)st.st_size) {
+		fprintf(stderr, "%s: not a binary index\n", path);
+		munmap(map, st.st_size);
+		return NULL;
+	}
+
+	invindex_t ind = newindex(NULL, mem);
+	ind->map = map;
+	ind->map_len = st.st_size;
+	ind->hdr = h;
+	ind->block = (const struct dict_block *)((char *)map + off[SEC_BLOCK]);
+	ind->doc_off = (const uint64_t *)((char *)map + off[SEC_DOC_OFF]);
+	ind->doc_len = (const uint32_t *)((char *)map + off[SEC_DOC_LEN]);
+	ind->dict = (const unsigned char *)map + off[SEC_DICT];
+	ind->docstr = (const char *)map + off[SEC_DOCS];
+	ind->blob = (const unsigned char *)map + off[SEC_BLOB];
+	ind->term = arena_alloc(ind->mem, h->max_word + 1);
+
+	return ind;
+}
+
+// decode the posting list of @word from a mapped index, NULL if the word
+// is not in it
+static invurl_t map_token(invindex_t ind, char *word)
+{
+	// decoded before
+	int t = find_str(ind->words, word);
+	if (t >= 0)
+		return ind->tokens[t];
+
+	// the last block whose first word is not after @word
+	unsigned count, len;
+	int lo = 0;
+	int hi = dict_blocks(ind->hdr);
+	while (lo < hi) {
+		const int mid = lo + (hi - lo) / 2;
+		get_entry(ind->dict + ind->block[mid].dict, ind->term, &count, &len);
+		if (strcmp(ind->term, word) <= 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	if (lo == 0)
+		return NULL;
+
+	// scan it, adding up where the posting lists start
+	const int b = lo - 1;
+	const unsigned char *in = ind->dict + ind->block[b].dict;
+	uint64_t off = ind->block[b].blob;
+	for (int i = b * DICT_BLOCK;
+	     i < (b + 1) * DICT_BLOCK && i < (int)ind->hdr->nwords; i++) {
+		in += get_entry(in, ind->term, &count, &len);
+		const int cmp = strcmp(word, ind->term);
+		if (cmp < 0)
+			break;
+		if (cmp > 0) {
+			off += len;
+			continue;
+		}
+
+		invurl_t u = new_token(ind, word);
+		u->docs = arena_alloc(ind->mem, (count + 1) * sizeof(unsigned));
+		u->tf = arena_alloc(ind->mem, (count + 1) * sizeof(unsigned));
+		u->urls = arena_alloc(ind->mem, (count + 1) * sizeof(char *));
+		const unsigned char *post = ind->blob + off;
+		post += decode_deltas(post, count, u->docs);
+		decode_varints(post, count, u->tf);
+		for (unsigned j = 0; j < count; j++)
+			u->urls[j] = (char *)ind->docstr + ind->doc_off[u->docs[j]];
+		u->count = u->maxurl = count;
+		return u;
+	}
+	return NULL;
+}
+
 // read file content into an invindex_t
-invindex_t read_index(char *path)
+invindex_t read_index(char *path, doctab_t docs, arena_t mem)
 {
 	FILE *fp = fopen(path, "r");
 	DUMP_ERR(fp, "Cannot open file");
 
-	invindex_t ind = newindex();
+	invindex_t ind = newindex(docs, mem);
 	char *buf;
 
 	while (fscanf(fp, "%m[^\n]\n", &buf) != EOF) {
-		// split by space
+		// split by space, the key stays put in @buf
 		char *token = strtok(buf, " ");
-		// copy token to key
-		char *key = malloc(strlen(token) + 1);
-		strcpy(key, token);
+		char *key = token;
 		// use this variable to skip reading the keyword
 		int add_url = 0;
 
@@ -239,7 +649,6 @@ invindex_t read_index(char *path)
 			add_url = 1;
 		}
 
-		free(key);
 		free(buf);
 	}
 
@@ -247,34 +656,37 @@ invindex_t read_index(char *path)
 	return ind;
 }
 
-static invurl_t *search_tok(invindex_t ind, char *word)
+// posting list of @word, NULL if it is not indexed
+static invurl_t find_token(invindex_t ind, char *word)
+{
+	if (ind->map)
+		return map_token(ind, word);
+
+	finalize(ind);
+	int t = find_str(ind->words, word);
+	return t >= 0 ? ind->tokens[t] : NULL;
+}
+
+// return the sorted doc ids of @word
+// the list is owned by the index and valid until the next add_entry
+const unsigned *docs_for(invindex_t ind, char *word, int *size)
 {
 	assert(ind);
-	assert(word);
-
-	// create an target struct
-	invurl_t key = malloc(sizeof(struct _invurl));
-	key->word = malloc(strlen(word) + 1);
-	strcpy(key->word, word);
-	// check if word is in invindex
-	sort_tok(ind);
-	invurl_t *tok = bsearch(&key, ind->tokens, ind->size, \
-				sizeof(invurl_t), _tok_cmp);
-	free(key->word);
-	free(key);
-
-	return tok;
+	invurl_t u = find_token(ind, word);
+	*size = u ? u->count : 0;
+	return u ? u->docs : NULL;
 }
 
 // return a url list for @word
+// the list is owned by the index and valid until the next add_entry
 char **url_for(invindex_t ind, char *word, int *size)
 {
 	assert(ind);
 
-	invurl_t *tok = search_tok(ind, word);
-	if (tok) {
-		*size = (*tok)->count;
-		return (*tok)->urls;
+	invurl_t u = find_token(ind, word);
+	if (u) {
+		*size = u->count;
+		return u->urls;
 	} else {
 		// not found
 		// array size is 0
@@ -282,3 +694,69 @@ char **url_for(invindex_t ind, char *word, int *size)
 		return NULL;
 	}
 }
+
+// return the term counts of @word, in the order of docs_for
+// the list is owned by the index and valid until the next add_entry
+const unsigned *tf_for(invindex_t ind, char *word, int *size)
+{
+	assert(ind);
+	invurl_t u = find_token(ind, word);
+	*size = u ? u->count : 0;
+	return u ? u->tf : NULL;
+}
+
+// return the doc id of @url, -1 if it is not indexed
+int index_doc(invindex_t ind, char *url)
+{
+	assert(ind && url);
+	if (!ind->map)
+		return doc_id(ind->docs, url);
+
+	// doc ids follow url order, binary search the urls
+	int lo = 0;
+	int hi = ind->hdr->ndocs;
+	while (lo < hi) {
+		const int mid = lo + (hi - lo) / 2;
+		const int cmp = strcmp(url, ind->docstr + ind->doc_off[mid]);
+		if (cmp == 0)
+			return mid;
+		else if (cmp < 0)
+			hi = mid;
+		else
+			lo = mid + 1;
+	}
+	return -1;
+}
+
+// return the number of docs known to the index
+int index_ndocs(invindex_t ind)
+{
+	assert(ind);
+	return ind->map ? (int)ind->hdr->ndocs : ndocs(ind->docs);
+}
+
+// return the url of doc @doc
+char *index_url(invindex_t ind, int doc)
+{
+	assert(ind);
+	if (ind->map)
+		return (char *)ind->docstr + ind->doc_off[doc];
+	return doc_url(ind->docs, doc);
+}
+
+// return the number of words of doc @doc, 0 if unknown
+int doc_len(invindex_t ind, int doc)
+{
+	assert(ind);
+	if (ind->map)
+		return ind->doc_len[doc];
+	return ind->doclen ? (int)ind->doclen[doc] : 0;
+}
+
+// whether the index knows term counts and document lengths, which an
+// index read from invertedIndex.txt does not
+int has_tf(invindex_t ind)
+{
+	assert(ind);
+	return ind->map || ind->doclen;
+}
@@ -1,19 +1,33 @@
 #ifndef INVINDEX_H
 #define INVINDEX_H
 
-/* Inverted index can be implemented with set (and map) but I do not have time
- * to implement the whole data structure. Therefor simple array is used here
+/* Inverted index backed by a hash table of words. Postings are doc ids
+ * from a doctab_t with the number of times the word occurs in each,
+ * appended as they come and sorted once, when the index is first read.
  */
 
+#include "doctab.h"
+#include "arena.h"
+
 typedef struct _invurl *invurl_t;
 typedef struct _invindex *invindex_t;
 
-invindex_t newindex(void);
-invindex_t read_index(char *);
+invindex_t newindex(doctab_t, arena_t);
+invindex_t read_index(char *, doctab_t, arena_t);
+invindex_t map_index(char *, arena_t);
 void add_entry(invindex_t, char *, char *);
+void set_doc_len(invindex_t, char *, int);
 void show_index(invindex_t);
 void output_index(invindex_t, char*);
+void output_postings(invindex_t, char *);
 char **url_for(invindex_t, char *, int *);
+const unsigned *docs_for(invindex_t, char *, int *);
+const unsigned *tf_for(invindex_t, char *, int *);
+int index_doc(invindex_t, char *);
+char *index_url(invindex_t, int);
+int index_ndocs(invindex_t);
+int doc_len(invindex_t, int);
+int has_tf(invindex_t);
 void free_index(invindex_t ind);
 
 #endif
@@ -0,0 +1,158 @@
+// k-way merge of sorted doc id lists
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include "match.h"
+
+// macro for dumping error messages
+#ifndef DUMP_ERR
+#define DUMP_ERR(ptr, str)				\
+	if (ptr == NULL) {				\
+		perror(str);				\
+		exit(EXIT_FAILURE);			\
+	}
+#endif
+
+// next unread doc of one list
+struct cursor {
+	unsigned doc;
+	int list;
+	int pos;
+};
+
+// order cursors by doc, then by list
+static int before(const struct cursor *a, const struct cursor *b)
+{
+	return a->doc < b->doc || (a->doc == b->doc && a->list < b->list);
+}
+
+// restore the min-heap property of @heap from @i down
+static void sift_down(struct cursor *heap, int n, int i)
+{
+	for (;;) {
+		int min = i;
+		const int l = 2 * i + 1;
+		const int r = l + 1;
+		if (l < n && before(&heap[l], &heap[min])) min = l;
+		if (r < n && before(&heap[r], &heap[min])) min = r;
+		if (min == i) return;
+
+		struct cursor tmp = heap[i];
+		heap[i] = heap[min];
+		heap[min] = tmp;
+		i = min;
+	}
+}
+
+/*
+ * merge_postings - match the doc id lists of a query
+ * @lists: @nlists ascending doc id lists, empty ones may be NULL
+ * @tfs: term counts in the order of @lists, or NULL
+ * @sizes: length of each list
+ * @size: set to the number of docs returned
+ *
+ * With @tfs, the tf of each match points at @nlists counts, one per
+ * list and 0 for lists without the doc. They are stored after the
+ * matches, so freeing the returned array frees them too.
+ *
+ * The lists are merged through a heap of their heads, so each posting is
+ * read once and costs O(log nlists). Docs are returned by descending
+ * count; docs with the same count by the first list that holds them and
+ * then by doc id, which is the order a search has always listed them in.
+ */
+match_t *merge_postings(const unsigned **lists, const unsigned **tfs,
+			const int *sizes, int nlists, int *size)
+{
+	assert(size);
+
+	long total = 0;
+	for (int i = 0; i < nlists; i++)
+		total += sizes[i];
+
+	struct cursor *heap = malloc((nlists + 1) * sizeof(struct cursor));
+	match_t *found = malloc((total + 1) * sizeof(match_t));
+	DUMP_ERR(heap, "malloc failed");
+	DUMP_ERR(found, "malloc failed");
+	// a row of term counts per doc found, grown with the docs
+	unsigned *rows = NULL;
+	size_t max_rows = 0;
+
+	int n = 0;
+	for (int i = 0; i < nlists; i++) {
+		if (sizes[i] == 0) continue;
+		heap[n].doc = lists[i][0];
+		heap[n].list = i;
+		heap[n++].pos = 0;
+	}
+	for (int i = n / 2 - 1; i >= 0; i--)
+		sift_down(heap, n, i);
+
+	// docs come out in ascending order, the first time from the
+	// lowest list holding them
+	int nfound = 0;
+	while (n > 0) {
+		struct cursor *top = &heap[0];
+		if (nfound == 0 || found[nfound - 1].doc != top->doc) {
+			found[nfound].doc = top->doc;
+			found[nfound].count = 0;
+			found[nfound].tf = NULL;
+			found[nfound].first = top->list;
+			if (tfs && (size_t)nfound == max_rows) {
+				max_rows = max_rows ? 2 * max_rows : 64;
+				unsigned *tmp = realloc(rows, max_rows * nlists *
+							sizeof(unsigned));
+				DUMP_ERR(tmp, "realloc failed");
+				rows = tmp;
+			}
+			if (tfs)
+				memset(rows + (size_t)nfound * nlists, 0,
+				       nlists * sizeof(unsigned));
+			nfound++;
+		}
+		found[nfound - 1].count++;
+		if (tfs)
+			rows[(size_t)(nfound - 1) * nlists + top->list] =
+				tfs[top->list][top->pos];
+
+		if (++top->pos < sizes[top->list])
+			top->doc = lists[top->list][top->pos];
+		else
+			heap[0] = heap[--n];
+		sift_down(heap, n, 0);
+	}
+	free(heap);
+	for (int i = 0; tfs && i < nfound; i++)
+		found[i].tf = rows + (size_t)i * nlists;
+
+	// stable counting sort on (count descending, first list ascending)
+	const int nkeys = nlists * nlists;
+	int *start = calloc(nkeys + 1, sizeof(int));
+	const size_t row = tfs ? (size_t)nlists * sizeof(unsigned) : 0;
+	match_t *sorted = malloc(((size_t)nfound + 1) * (sizeof(match_t) + row));
+	DUMP_ERR(start, "calloc failed");
+	DUMP_ERR(sorted, "malloc failed");
+	for (int i = 0; i < nfound; i++)
+		start[(nlists - found[i].count) * nlists + found[i].first + 1]++;
+	for (int k = 0; k < nkeys; k++)
+		start[k + 1] += start[k];
+	for (int i = 0; i < nfound; i++)
+		sorted[start[(nlists - found[i].count) * nlists + found[i].first]++]
+			= found[i];
+
+	// move the counts next to the matches, in their new order
+	unsigned *moved = (unsigned *)(sorted + nfound + 1);
+	for (int i = 0; tfs && i < nfound; i++) {
+		memcpy(moved, sorted[i].tf, row);
+		sorted[i].tf = moved;
+		moved += nlists;
+	}
+
+	free(start);
+	free(found);
+	free(rows);
+	*size = nfound;
+	return sorted;
+}
@@ -0,0 +1,22 @@
+// match.h ... Interface to matching the posting lists of a query
+//
+// Every query term has a sorted list of doc ids. merge_postings walks
+// all of them at once and returns each doc found with the number of
+// terms it matches, best matches first. Given the term counts of the
+// lists too, it hands each doc its count of every term, so a scorer
+// needs no lookup per doc.
+
+#ifndef MATCH_H
+#define MATCH_H
+
+typedef struct {
+	unsigned doc;	// doc id
+	int count;	// number of lists holding @doc
+	int first;	// first list holding @doc
+	unsigned *tf;	// count of each term in @doc, NULL if not asked for
+} match_t;
+
+match_t *merge_postings(const unsigned **, const unsigned **, const int *,
+			int, int *);
+
+#endif
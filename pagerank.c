@@ -1,37 +1,242 @@
+// getopt is POSIX
+#define _POSIX_C_SOURCE 200809L
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <math.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <sys/stat.h>
 
 #include "url.h"
 #include "graph.h"
 #include "parser.h"
+#include "ingest.h"
+#include "pool.h"
+#include "spmv.h"
+#include "stats.h"
+#include "perf.h"
+#include "reorder.h"
+#include "tile.h"
+
+// command line options
+typedef struct {
+	double d;		// damping factor
+	double diff_pr;		// stop when the rank change drops below this
+	int max_iter;		// maximum number of iterations
+	int nthreads;		// -t, number of threads
+	const kernel_t *kernel;	// -k, spmv kernel, best supported by default
+	int gauss_seidel;	// -g, update ranks in place
+	int verbose;		// -v, print the residual of every iteration
+	char *warm;		// -w, previous pagerankList.txt to start from
+	char *changed;		// -c, urls whose links changed since then
+	char *snapshot;		// -s, binary graph snapshot to load or write
+	const order_t *order;	// -r, url order of the rank loop, NULL keeps ids
+	int tile;		// -b, tile side of the blocked loop, 0 if off
+	int single;		// -p float, single precision ranks and weights
+	int finish;		// -f, one double precision iteration after them
+	perf_t perf;		// --perf, hardware counters, NULL if off
+} opt_t;
+
+// state shared by the threads of one iteration
+typedef struct {
+	const kernel_t *k;
+	const int *off;		// in-link offsets of each url
+	const int *adj;		// in-links
+	const double *w;	// edge weights from get_weights
+	const double *pr;	// ranks of the previous iteration
+	double *next;		// ranks being computed
+	const int *bound;	// thread i owns urls [bound[i], bound[i + 1])
+	double *diff;		// per thread sum of rank changes
+	tiles_t tiles;		// in-links in tiles, with -b
+	const float *w32;	// @w, @pr and @next in single precision, -p float
+	const float *pr32;
+	float *next32;
+	double fterm;
+	double d;
+} iter_t;
 
-static urll_t page_rank(graph_t, handle_t, double, double, int);
-static graph_t get_graph(handle_t);
-static double weight_out(graph_t g, int pj, int pi);
-static double weight_in(graph_t g, int pj, int pi);
+static urll_t page_rank(graph_t, handle_t, const opt_t *, arena_t);
+static int iterate(graph_t, const double *, const float *, double *,
+		   double *, int, const opt_t *);
+static void push_rank(graph_t, const double *, double *, int, const opt_t *);
+static void load_ranks(graph_t, char *, double *, int);
+static graph_t get_graph(handle_t, int);
+static void add_links(void *, char *, handle_t);
+static uint64_t *page_stamps(handle_t);
+static graph_t get_snapshot(char *, handle_t, const uint64_t *);
+static double *get_weights(graph_t g);
+static int *partition(const int *off, int nv, int n);
+static void rank_range(void *arg, int id, int n);
+static void rank_range_gs(void *arg, int id, int n);
+static void rank_range_tiled(void *arg, int id, int n);
+static void rank_range32(void *arg, int id, int n);
+static float *to_float(const double *, long);
+static double *finish_double(graph_t, const double *, const double *, int,
+			     const opt_t *);
+static void compare_precision(graph_t, const double *, double *,
+			      const double *, const double *, int,
+			      const opt_t *);
+static void report_deviation(const char *, const char *, const double *,
+			     const double *, int, int);
 
 int main(int argc, char **argv)
 {
-	if (argc != 4) {
+	opt_t opt = { .nthreads = 1, .kernel = best_kernel() };
+	// --stats[=file], dumps timings as JSON to @stats_path or stderr;
+	// --perf adds hardware counters to them
+	static const struct option longopts[] = {
+		{ "stats", optional_argument, NULL, 'S' },
+		{ "perf", no_argument, NULL, 'P' },
+		{ NULL, 0, NULL, 0 }
+	};
+	char *stats_path = NULL;
+	int perf = 0;
+	int c;
+
+	while ((c = getopt_long(argc, argv, "t:k:gvw:c:s:r:b:p:f", longopts,
+				NULL)) != -1) {
+		switch (c) {
+		case 'S':
+			stats_enable();
+			stats_path = optarg;
+			break;
+		case 'P':
+			perf = 1;
+			break;
+		case 't':
+			opt.nthreads = atoi(optarg);
+			break;
+		case 'k':
+			opt.kernel = find_kernel(optarg);
+			if (opt.kernel == NULL)
+				fprintf(stderr, "kernel %s is not supported\n",
+					optarg);
+			break;
+		case 'g':
+			opt.gauss_seidel = 1;
+			break;
+		case 'v':
+			opt.verbose = 1;
+			break;
+		case 'w':
+			opt.warm = optarg;
+			break;
+		case 'c':
+			opt.changed = optarg;
+			break;
+		case 's':
+			opt.snapshot = optarg;
+			break;
+		case 'b':
+			// 0 picks the size from the cache
+			opt.tile = atoi(optarg);
+			if (opt.tile == 0) {
+				opt.tile = tile_size();
+			} else if (opt.tile < MIN_TILE) {
+				fprintf(stderr, "tileSize must be 0 or at "
+					"least %d\n", MIN_TILE);
+				argc = 0;
+			}
+			break;
+		case 'p':
+			if (strcmp(optarg, "float") == 0) {
+				opt.single = 1;
+			} else if (strcmp(optarg, "double") != 0) {
+				fprintf(stderr, "precision %s is not supported\n",
+					optarg);
+				argc = 0;
+			}
+			break;
+		case 'f':
+			opt.finish = 1;
+			break;
+		case 'r':
+			opt.order = find_order(optarg);
+			if (opt.order == NULL) {
+				fprintf(stderr, "order %s is not supported\n",
+					optarg);
+				argc = 0;
+			}
+			break;
+		default:
+			argc = 0;
+		}
+	}
+
+	if (argc - optind != 3 || opt.nthreads < 1 || opt.kernel == NULL ||
+	    (opt.changed && !opt.warm) || (opt.order && opt.warm) ||
+	    (opt.tile && (opt.warm || opt.gauss_seidel)) ||
+	    (opt.single && (opt.warm || opt.gauss_seidel || opt.tile)) ||
+	    (opt.finish && !opt.single)) {
 		fprintf(stderr,
-			"Usage: %s [d] [diffPR] [maxIterations]\n", argv[0]);
+			"Usage: %s [-t threads] [-k avx512|avx2|scalar] [-g] [-v] "
+			"[-w prevList [-c changedUrls]] [-s snapshot] "
+			"[-r degree|rcm|gorder] [-b tileSize] [-p double|float [-f]] "
+			"[--stats[=file]] [--perf] [d] [diffPR] [maxIterations]\n",
+			argv[0]);
 		return EXIT_FAILURE;
 	}
+	// before any thread is started, so the pool's threads are counted
+	if (perf) {
+		stats_enable();
+		opt.perf = new_perf();
+	}
+	opt.d = atof(argv[optind]);
+	opt.diff_pr = atof(argv[optind + 1]);
+	opt.max_iter = atoi(argv[optind + 2]);
 
 	handle_t cltn = parse("collection.txt");
-	graph_t g = get_graph(cltn);
+	double t = stats_start();
+	uint64_t *stamp = opt.snapshot ? page_stamps(cltn) : NULL;
+	graph_t g = opt.snapshot ? get_snapshot(opt.snapshot, cltn, stamp) : NULL;
+	if (g)
+		stats_stop("load_graph", t);
+	if (g == NULL) {
+		t = stats_start();
+		g = get_graph(cltn, opt.nthreads);
+		stats_stop("get_graph", t);
+		if (opt.snapshot)
+			save_graph(g, opt.snapshot, stamp, 2 * handle_size(cltn));
+	}
+	free(stamp);
+	stats_count("vertices", nvertices(g));
+	stats_count("edges", nedges(g));
 
-	urll_t l = page_rank(g, cltn, atof(argv[1]), atof(argv[2]), atoi(argv[3]));
+	// the url list is built in one arena and freed in one go
+	arena_t mem = new_arena(0);
+	urll_t l = page_rank(g, cltn, &opt, mem);
+	t = stats_start();
 	output(l, "pagerankList.txt");
+	stats_stop("output", t);
+	if (opt.verbose) {
+		struct arena_stats st;
+		arena_stats(mem, &st);
+		printf("url list: %ld allocations in %ld blocks, "
+		       "%zu bytes used, %zu bytes peak\n",
+		       st.nalloc, st.nblocks, st.used, st.peak);
+	}
 	free_list(l);
+	free_arena(mem);
 	free_handle(cltn);
 	free_graph(g);
+	if (stats_enabled())
+		stats_save(stats_path);
+	free_perf(opt.perf);
 	return 0;
 }
 
-static graph_t get_graph(handle_t collection)
+// add an edge from @url to every link on its page
+static void add_links(void *arg, char *url, handle_t page)
+{
+	graph_t g = arg;
+	for (int j = 0; j < handle_size(page); j++)
+		add_edge(g, url, getbuf(page, j));
+}
+
+static graph_t get_graph(handle_t collection, int nthreads)
 {
 	graph_t g = new_graph();
 
@@ -43,100 +248,749 @@ static graph_t get_graph(handle_t collection)
 	for (int i = 0; i < handle_size(collection); i++)
 		add_edge(g, getbuf(collection, i), getbuf(collection, i));
 
-	for (int i = 0; i < handle_size(collection); i++) {
-		// stores file path and file name
-		// e.g. url1234.txt
-		char *fname = malloc(strlen(getbuf(collection, i)) + 4);
+	// parse url?.txt on @nthreads threads, links are still added in
+	// collection order so the graph does not depend on @nthreads
+	for_each_page(collection, "#start Section-1", "#end Section-1", 0,
+		      nthreads, add_links, g);
+
+	return g;
+}
+
+/*
+ * page_stamps - size and modification time of every page of @cltn
+ *
+ * Page i gets stamp[2 * i] and stamp[2 * i + 1], both 0 if its file is
+ * missing. A snapshot is only used while every page still matches.
+ */
+static uint64_t *page_stamps(handle_t cltn)
+{
+	const int n = handle_size(cltn);
+	uint64_t *stamp = calloc(2 * (size_t)n + 1, sizeof(uint64_t));
+	if (stamp == NULL) {
+		perror("calloc failed");
+		exit(EXIT_FAILURE);
+	}
+	for (int i = 0; i < n; i++) {
+		char *fname = malloc(strlen(getbuf(cltn, i)) + 5);
 		if (fname == NULL) {
 			perror("malloc failed");
 			exit(EXIT_FAILURE);
 		}
-		sprintf(fname, "%s.txt", getbuf(collection, i));
-		
-		// parse url?.txt
-		handle_t hd = parse_url(fname, "#start Section-1", "#end Section-1");
-		// for each link in url?.txt
-		// add edge from this url to that link
-		for (int j = 0; j < handle_size(hd); j++)
-			add_edge(g, getbuf(collection, i), getbuf(hd, j));
-
-		// free memory used in this for iteration
+		sprintf(fname, "%s.txt", getbuf(cltn, i));
+		struct stat st;
+		if (stat(fname, &st) == 0) {
+			stamp[2 * i] = st.st_size;
+			stamp[2 * i + 1] = (uint64_t)st.st_mtim.tv_sec *
+				1000000000 + st.st_mtim.tv_nsec;
+		}
 		free(fname);
-		free_handle(hd);
 	}
+	return stamp;
+}
 
+// load the graph snapshot at @path, NULL if there is none or if it was
+// built from a different collection or from pages that changed since,
+// as told by @stamp (see page_stamps)
+static graph_t get_snapshot(char *path, handle_t cltn, const uint64_t *stamp)
+{
+	graph_t g = load_graph(path);
+	if (g == NULL)
+		return NULL;
+
+	// urls of the collection come first, in collection order
+	int stale = nvertices(g) < handle_size(cltn);
+	for (int i = 0; !stale && i < handle_size(cltn); i++)
+		stale = strcmp(id_to_name(g, i), getbuf(cltn, i)) != 0;
+	int nstamp;
+	const uint64_t *saved = graph_stamps(g, &nstamp);
+	stale = stale || nstamp != 2 * handle_size(cltn);
+	if (stale)
+		fprintf(stderr, "%s does not match collection.txt, rebuilding\n",
+			path);
+	for (int i = 0; !stale && i < handle_size(cltn); i++) {
+		stale = memcmp(&saved[2 * i], &stamp[2 * i],
+			       2 * sizeof(uint64_t)) != 0;
+		if (stale)
+			fprintf(stderr, "%s.txt changed since %s was saved, "
+				"rebuilding\n", getbuf(cltn, i), path);
+	}
+	if (stale) {
+		free_graph(g);
+		return NULL;
+	}
 	return g;
 }
 
 static urll_t page_rank(const graph_t g,
 			const handle_t cltn,
-			const double d,
-			const double diff_pr,
-			const int max_iter)
+			const opt_t *opt,
+			arena_t mem)
+{
+	urll_t li = new_url_list(g, cltn, mem);
+	const int nv = handle_size(cltn);
+
+	// Win * Wout for every in-edge, aligned with in_links(g); -p float
+	// keeps only a single precision copy
+	double t = stats_start();
+	double *w = get_weights(g);
+	float *w32 = NULL;
+	if (opt->single) {
+		w32 = to_float(w, in_offsets(g)[nv]);
+		free(w);
+		w = NULL;
+	}
+	stats_stop("get_weights", t);
+	double *pr = malloc(nv * sizeof(double));
+	if (pr == NULL) {
+		perror("malloc failed");
+		exit(EXIT_FAILURE);
+	}
+	for (int i = 0; i < nv; i++)
+		pr[i] = getwpr(li, i);
+
+	if (opt->warm) {
+		load_ranks(g, opt->warm, pr, nv);
+		push_rank(g, w, pr, nv, opt);
+	} else {
+		// the starting ranks, for a double precision run to compare with
+		double *ref = NULL;
+		if (opt->single && (opt->verbose || stats_enabled())) {
+			ref = malloc(nv * sizeof(double));
+			if (ref == NULL) {
+				perror("malloc failed");
+				exit(EXIT_FAILURE);
+			}
+			memcpy(ref, pr, nv * sizeof(double));
+		}
+		// the ranks before the last iteration, for -f
+		double *prev = NULL;
+		if (opt->finish) {
+			prev = malloc(nv * sizeof(double));
+			if (prev == NULL) {
+				perror("malloc failed");
+				exit(EXIT_FAILURE);
+			}
+		}
+		const int iter = iterate(g, w, w32, prev, pr, nv, opt);
+		free(w32);
+
+		// -f and the comparison want the double weights back
+		if (opt->single && (opt->finish || ref)) {
+			t = stats_start();
+			w = get_weights(g);
+			stats_stop("get_weights", t);
+		}
+		// @raw keeps the float ranks @pr once -f replaces them
+		double *raw = NULL;
+		if (opt->finish && iter > 0) {
+			raw = pr;
+			pr = finish_double(g, w, prev, nv, opt);
+		}
+		if (ref)
+			compare_precision(g, w, ref, raw ? raw : pr,
+					  raw ? pr : NULL, nv, opt);
+		free(raw);
+		free(prev);
+		free(ref);
+	}
+
+	for (int i = 0; i < nv; i++)
+		setwpr(li, i, pr[i]);
+	free(pr);
+	free(w);
+	return li;
+}
+
+// run jacobi or gauss-seidel iterations on @pr until it converges, with
+// the weights @w, or @w32 in single precision, and return how many ran;
+// @prev, if not NULL, gets the -p float ranks before the last of them
+static int iterate(graph_t g, const double *w, const float *w32,
+		   double *prev, double *pr, int nv, const opt_t *opt)
 {
-	urll_t li = new_url_list(g, cltn);
 	int iter = 0;
-	double diff = diff_pr;
+	double diff = opt->diff_pr;
 
-	// first term in the formula
-	const double fterm = (1 - d) / handle_size(cltn);
-	while (iter < max_iter && diff >= diff_pr) {
-		diff = 0;
+	// next wpr values
+	double *wpr_list = malloc(nv * sizeof(double));
+	double *tdiff = malloc(opt->nthreads * sizeof(double));
+	if (wpr_list == NULL || tdiff == NULL) {
+		perror("malloc failed");
+		exit(EXIT_FAILURE);
+	}
+	double *const out = pr;
+
+	// with -r the loop runs on relabelled urls, @perm maps them back
+	const int *off = in_offsets(g);
+	const int *adj = in_links(g);
+	int *perm = NULL;
+	int *poff = NULL;
+	int *padj = NULL;
+	double *pw = NULL;
+	float *pw32 = NULL;
+	if (opt->order) {
+		const double t = stats_start();
+		perm = opt->order->order(g, nv);
+		poff = malloc((nv + 1) * sizeof(int));
+		padj = malloc((off[nv] + 1) * sizeof(int));
+		if (w32)
+			pw32 = malloc((off[nv] + 1) * sizeof(float));
+		else
+			pw = malloc((off[nv] + 1) * sizeof(double));
+		pr = malloc(nv * sizeof(double));
+		if (!poff || !padj || (!pw && !pw32) || !pr) {
+			perror("malloc failed");
+			exit(EXIT_FAILURE);
+		}
+		permute_links(off, adj, w, perm, nv, poff, padj, pw);
+		// rows keep their links in order, so the float weights follow
+		for (int i = 0; pw32 && i < nv; i++)
+			memcpy(pw32 + poff[i], w32 + off[perm[i]],
+			       (poff[i + 1] - poff[i]) * sizeof(float));
+		for (int i = 0; i < nv; i++)
+			pr[i] = out[perm[i]];
+		stats_stop("reorder", t);
+
+		const double before = log_gap(off, adj, nv);
+		const double after = log_gap(poff, padj, nv);
+		stats_set("reorder.log_gap_before", before);
+		stats_set("reorder.log_gap_after", after);
+		if (opt->verbose)
+			printf("%s order: mean log gap %.3f -> %.3f\n",
+			       opt->order->name, before, after);
+		off = poff;
+		adj = padj;
+		w = pw;
+		w32 = pw32;
+	}
+
+	pool_t pool = new_pool(opt->nthreads);
+	int *bound = partition(off, nv, opt->nthreads);
+	iter_t it = {
+		.k = opt->kernel,
+		.off = off,
+		.adj = adj,
+		.w = w,
+		.bound = bound,
+		.diff = tdiff,
+		.tiles = NULL,
+		// first term in the formula
+		.fterm = (1 - opt->d) / nv,
+		.d = opt->d,
+	};
+
+	// every iteration reads each in-edge of the collection's urls once
+	const long edges = it.off[nv];
+	task_fn task = opt->gauss_seidel ? rank_range_gs : rank_range;
+	if (opt->tile) {
+		const double t = stats_start();
+		it.tiles = new_tiles(off, adj, w, bound, opt->nthreads, opt->tile);
+		stats_stop("get_tiles", t);
+		stats_count("tiles", tiles_count(it.tiles));
+		if (opt->verbose)
+			printf("%ld tiles of %d urls a side\n",
+			       tiles_count(it.tiles), tiles_side(it.tiles));
+		task = rank_range_tiled;
+	}
+	// rank copies the 32 bit kernels work on
+	float *pr32 = NULL;
+	float *next32 = NULL;
+	if (opt->single) {
+		pr32 = to_float(pr, nv);
+		next32 = to_float(pr, nv);
+		it.w32 = w32;
+		task = rank_range32;
+	}
+
+	perf_start(opt->perf);
+	while (iter < opt->max_iter && diff >= opt->diff_pr) {
+		const double start = stats_start();
 		iter++;
-		// stores new wpr value
-		double *wpr_list = calloc(handle_size(cltn), sizeof(double));
-
-		for (int i = 0; i < handle_size(cltn); i++) {
-			int size = 0;
-			// M(pi)
-			int *url_to = nodes_to(g, i, &size);
-			// sum(PR(pj;t) * Win * Wout
+		it.pr = pr;
+		it.next = wpr_list;
+		it.pr32 = pr32;
+		it.next32 = next32;
+		pool_run(pool, task, &it);
+
+		// combine in thread order so the result only depends on the
+		// number of threads, not on their timing
+		diff = 0;
+		for (int t = 0; t < opt->nthreads; t++)
+			diff += tdiff[t];
+		if (opt->verbose)
+			printf("iteration %d residual %.10g\n", iter, diff);
+
+		stats_sample("iteration_ms", stats_stop("iteration", start) * 1e3);
+		stats_sample("residual", diff);
+		stats_sample("edges_touched", edges);
+		stats_count("edges_touched", edges);
+
+		double *tmp = pr;
+		pr = wpr_list;
+		wpr_list = tmp;
+		float *tmp32 = pr32;
+		pr32 = next32;
+		next32 = tmp32;
+	}
+
+	perf_stop(opt->perf, "iterate", "edge", edges * iter);
+	if (opt->single) {
+		for (int i = 0; i < nv; i++)
+			pr[i] = pr32[i];
+		for (int i = 0; prev && i < nv; i++)
+			prev[perm ? perm[i] : i] = next32[i];
+	}
+
+	if (opt->verbose)
+		printf("%s: %d iterations, residual %.10g\n",
+		       opt->gauss_seidel ? "gauss-seidel" : "jacobi", iter, diff);
+
+	// the latest ranks may sit in the scratch buffer
+	if (perm) {
+		for (int i = 0; i < nv; i++)
+			out[perm[i]] = pr[i];
+		free(pr);
+	} else if (pr != out) {
+		memcpy(out, pr, nv * sizeof(double));
+		wpr_list = pr;
+	}
+	free(perm);
+	free(poff);
+	free(padj);
+	free(pw);
+	free(pw32);
+	free_tiles(it.tiles);
+	free(pr32);
+	free(next32);
+	free_pool(pool);
+	free(bound);
+	free(tdiff);
+	free(wpr_list);
+	return iter;
+}
+
+// load the ranks of a previous pagerankList.txt into @pr, urls that are
+// not listed keep their current rank
+static void load_ranks(graph_t g, char *path, double *pr, int nv)
+{
+	FILE *fp = fopen(path, "r");
+	if (fp == NULL) {
+		perror("Failed to open file");
+		exit(EXIT_FAILURE);
+	}
+
+	char *url;
+	int deg;
+	double rank;
+	while (fscanf(fp, "%m[^,], %d, %lf\n", &url, &deg, &rank) == 3) {
+		int id = name_to_id(g, url);
+		if (id >= 0 && id < nv)
+			pr[id] = rank;
+		free(url);
+	}
+	fclose(fp);
+}
+
+// r[i] = PR(pi) computed from @pr minus pr[i], for every url in [0, nv)
+// returns the l1 norm of r
+static double residual(graph_t g, const double *w, const double *pr,
+		       double *r, int nv, double fterm, double d)
+{
+	const kernel_t *scalar = find_kernel("scalar");
+	scalar->spmv(in_offsets(g), in_links(g), w, pr, r, 0, nv, fterm, d);
+
+	double norm = 0;
+	for (int i = 0; i < nv; i++) {
+		r[i] -= pr[i];
+		norm += fabs(r[i]);
+	}
+	return norm;
+}
+
+/*
+ * push_rank - incremental pagerank from a warm start
+ *
+ * @pr holds the ranks of a previous run. Instead of sweeping the whole
+ * graph, the residual r = PR(p) - p is pushed along out-links: moving
+ * r[j] into pr[j] adds d * W(pj, pi) * r[j] to the residual of every
+ * url pj links to, so work only happens where ranks actually move.
+ * Urls whose residual exceeds diffPR / N are queued; once the queue is
+ * drained the residual of every url is below that, so its l1 norm is
+ * below diffPR, the same bound the jacobi iteration stops at.
+ *
+ * With -c, only the neighbourhood of the changed urls (their out-links,
+ * and everything that shares an in-link with those) is checked at the
+ * start. A full O(E) residual pass then confirms convergence and
+ * reseeds the queue if, e.g., a removed link was not listed; at most
+ * maxIterations such rounds are run.
+ */
+static void push_rank(graph_t g, const double *w, double *pr, int nv,
+		      const opt_t *opt)
+{
+	const int *in_off = in_offsets(g);
+	const int *in_adj = in_links(g);
+	const int *out_off = out_offsets(g);
+	const int *out_adj = out_links(g);
+	const int nall = nvertices(g);
+	const double fterm = (1 - opt->d) / nv;
+	const double eps = opt->diff_pr / nv;
+
+	// out-edge weights: walking the in-links in url order visits the
+	// out-links of each url in sorted order, matching out_links(g)
+	double *wo = malloc((nedges(g) + 1) * sizeof(double));
+	int *cur = malloc((nall + 1) * sizeof(int));
+	double *r = calloc(nv, sizeof(double));
+	int *queue = malloc((nv + 1) * sizeof(int));
+	char *queued = calloc(nall, sizeof(char));
+	if (!wo || !cur || !r || !queue || !queued) {
+		perror("malloc failed");
+		exit(EXIT_FAILURE);
+	}
+	memcpy(cur, out_off, (nall + 1) * sizeof(int));
+	for (int i = 0; i < nall; i++)
+		for (int e = in_off[i]; e < in_off[i + 1]; e++)
+			wo[cur[in_adj[e]]++] = w[e];
+
+	// circular queue, holds every url at most once
+	int head = 0, len = 0;
+#define ENQUEUE(v)							\
+	do {								\
+		if (!queued[v]) {					\
+			queued[v] = 1;					\
+			queue[(head + len++) % (nv + 1)] = (v);		\
+		}							\
+	} while (0)
+
+	if (opt->changed) {
+		handle_t ch = parse(opt->changed);
+		// mark changed urls and their out-links, then every url
+		// reachable from an in-link of those
+		int nmark = 0;
+		for (int k = 0; k < handle_size(ch); k++) {
+			int u = name_to_id(g, getbuf(ch, k));
+			if (u < 0) continue;
+			if (!queued[u]) { queued[u] = 1; cur[nmark++] = u; }
+			for (int e = out_off[u]; e < out_off[u + 1]; e++) {
+				int v = out_adj[e];
+				if (!queued[v]) { queued[v] = 1; cur[nmark++] = v; }
+			}
+		}
+		free_handle(ch);
+		for (int k = 0; k < nmark; k++) {
+			int v = cur[k];
+			for (int e = in_off[v]; e < in_off[v + 1]; e++) {
+				int pj = in_adj[e];
+				for (int f = out_off[pj]; f < out_off[pj + 1]; f++)
+					queued[out_adj[f]] = 1;
+			}
+		}
+
+		// exact residual of the marked urls
+		for (int i = 0; i < nv; i++) {
+			if (!queued[i]) continue;
+			queued[i] = 0;
 			double sum = 0;
-			for (int j = 0; j < size; j++)
-				sum += getwpr(li, url_to[j]) *
-					weight_in(g, url_to[j], i) *
-					weight_out(g, url_to[j], i);
-			// sum weight
-			wpr_list[i] = fterm + d * sum;
-			free(url_to);
+			for (int e = in_off[i]; e < in_off[i + 1]; e++)
+				sum += pr[in_adj[e]] * w[e];
+			r[i] = fterm + opt->d * sum - pr[i];
+			if (fabs(r[i]) > eps) ENQUEUE(i);
 		}
+		memset(queued + nv, 0, nall - nv);
+	}
+
+	long pushes = 0;
+	long edges = 0;
+	long touched = 0;
+	int round = 0;
+	double norm = opt->diff_pr;
+	perf_start(opt->perf);
+	while (round < opt->max_iter) {
+		const double start = stats_start();
+		const long edges_before = edges;
+		while (len > 0) {
+			const int j = queue[head];
+			head = (head + 1) % (nv + 1);
+			len--;
+			queued[j] = 0;
 
-		for (int i = 0; i < handle_size(cltn); i++) {
-			diff += fabs(wpr_list[i] - getwpr(li, i));
-			setwpr(li, i, wpr_list[i]);
+			const double rj = r[j];
+			if (fabs(rj) <= eps) continue;
+			pr[j] += rj;
+			r[j] = 0;
+			pushes++;
+			for (int e = out_off[j]; e < out_off[j + 1]; e++) {
+				const int i = out_adj[e];
+				// links to pages outside the collection are
+				// not ranked
+				if (i >= nv) continue;
+				r[i] += opt->d * wo[e] * rj;
+				if (fabs(r[i]) > eps) ENQUEUE(i);
+			}
+			edges += out_off[j + 1] - out_off[j];
 		}
-		free(wpr_list);
+
+		// confirm with the exact residual
+		round++;
+		norm = residual(g, w, pr, r, nv, fterm, opt->d);
+		// the residual check reads every in-edge too
+		stats_sample("iteration_ms", stats_stop("push_round", start) * 1e3);
+		stats_sample("residual", norm);
+		touched += edges - edges_before + in_off[nv];
+		stats_sample("edges_touched", edges - edges_before + in_off[nv]);
+		stats_count("edges_touched", edges - edges_before + in_off[nv]);
+		if (opt->verbose)
+			printf("round %d: %ld pushes, %ld edges, residual %.10g\n",
+			       round, pushes, edges, norm);
+		if (norm < opt->diff_pr)
+			break;
+		for (int i = 0; i < nv; i++)
+			if (fabs(r[i]) > eps) ENQUEUE(i);
+		if (len == 0)
+			break;
 	}
-	return li;
+#undef ENQUEUE
+	perf_stop(opt->perf, "push", "edge", touched);
+
+	if (opt->verbose)
+		printf("push: %d rounds, %ld pushes, residual %.10g\n",
+		       round, pushes, norm);
+	stats_count("pushes", pushes);
+
+	free(wo);
+	free(cur);
+	free(r);
+	free(queue);
+	free(queued);
+}
+
+// compute the new wpr of the urls owned by thread @id
+static void rank_range(void *arg, int id, int n)
+{
+	iter_t *it = arg;
+	const int lo = it->bound[id];
+	const int hi = it->bound[id + 1];
+
+	// PR(pi) = fterm + d * sum(PR(pj;t) * Win * Wout), pj in M(pi)
+	it->k->spmv(it->off, it->adj, it->w, it->pr, it->next, lo, hi,
+		    it->fterm, it->d);
+	it->diff[id] = it->k->l1diff(it->next + lo, it->pr + lo, hi - lo);
+}
+
+/*
+ * rank_range_gs - Gauss-Seidel variant of rank_range
+ *
+ * Each thread updates its own range in place, so within the range later
+ * urls already see the new ranks of earlier ones while ranks owned by
+ * other threads come from the previous iteration. With one thread this
+ * is plain Gauss-Seidel, and it stays deterministic for any thread count.
+ */
+static void rank_range_gs(void *arg, int id, int n)
+{
+	iter_t *it = arg;
+	const int lo = it->bound[id];
+	const int hi = it->bound[id + 1];
+
+	memcpy(it->next + lo, it->pr + lo, (hi - lo) * sizeof(double));
+	it->diff[id] = spmv_inplace(it->off, it->adj, it->w, it->pr, it->next,
+				    lo, hi, it->fterm, it->d);
+}
+
+// rank_range over the tiles of thread @id
+static void rank_range_tiled(void *arg, int id, int n)
+{
+	iter_t *it = arg;
+	it->diff[id] = tiles_spmv(it->tiles, id, it->pr, it->next, it->fterm,
+				  it->d);
 }
 
-static double weight_in(graph_t g, int pj, int pi)
+// rank_range with the 32 bit kernels
+static void rank_range32(void *arg, int id, int n)
 {
-	double deg_pi = indegree(g, pi);
-	double sum = 0;
-	int size = 0;
-	int *urls = nodes_from(g, pj, &size);
+	iter_t *it = arg;
+	const int lo = it->bound[id];
+	const int hi = it->bound[id + 1];
 
-	for (int i = 0; i < size; i++)
-		sum += indegree(g, urls[i]);
-	free(urls);
+	it->k->spmv32(it->off, it->adj, it->w32, it->pr32, it->next32, lo, hi,
+		      it->fterm, it->d);
+	it->diff[id] = it->k->l1diff32(it->next32 + lo, it->pr32 + lo, hi - lo);
+}
 
-	return deg_pi / sum;
+// single precision copy of @n values
+static float *to_float(const double *v, long n)
+{
+	float *f = malloc((n + 1) * sizeof(float));
+	if (f == NULL) {
+		perror("malloc failed");
+		exit(EXIT_FAILURE);
+	}
+	for (long i = 0; i < n; i++)
+		f[i] = (float)v[i];
+	return f;
 }
 
-static double weight_out(graph_t g, int pj, int pi)
+// -f, redo the last -p float iteration in double from the ranks @prev
+// before it, so the result keeps the resolution, and the ties, of a
+// double precision run
+static double *finish_double(graph_t g, const double *w, const double *prev,
+			     int nv, const opt_t *opt)
 {
-	double deg_pi = outdegree(g, pi);
-	deg_pi = deg_pi == 0 ? 0.5 : deg_pi;
-	double sum = 0;
-	int size = 0;
-	int *urls = nodes_from(g, pj, &size);
+	const double t = stats_start();
+	double *pr = malloc(nv * sizeof(double));
+	if (pr == NULL) {
+		perror("malloc failed");
+		exit(EXIT_FAILURE);
+	}
+	opt->kernel->spmv(in_offsets(g), in_links(g), w, prev, pr, 0, nv,
+			  (1 - opt->d) / nv, opt->d);
+	stats_stop("finish_double", t);
+	return pr;
+}
+
+/*
+ * compare_precision - how far the -p float ranks @pr are from double ones
+ *
+ * Runs single-threaded double precision Jacobi from the starting ranks
+ * @ref, which it overwrites, with the same stopping rule. Reports how far
+ * the raw float ranks @pr are from it, and with -f how far the ranks
+ * @fixed after the double iteration are.
+ */
+static void compare_precision(graph_t g, const double *w, double *ref,
+			      const double *pr, const double *fixed, int nv,
+			      const opt_t *opt)
+{
+	const int *off = in_offsets(g);
+	const int *adj = in_links(g);
+	double *cur = ref;
+	double *next = malloc(nv * sizeof(double));
+	if (next == NULL) {
+		perror("malloc failed");
+		exit(EXIT_FAILURE);
+	}
 
-	for (int i = 0; i < size; i++) {
-		double deg = outdegree(g, urls[i]);
-		sum += deg == 0 ? 0.5 : deg;
+	double diff = opt->diff_pr;
+	for (int iter = 0; iter < opt->max_iter && diff >= opt->diff_pr;
+	     iter++) {
+		opt->kernel->spmv(off, adj, w, cur, next, 0, nv,
+				  (1 - opt->d) / nv, opt->d);
+		diff = opt->kernel->l1diff(next, cur, nv);
+		double *tmp = cur;
+		cur = next;
+		next = tmp;
+	}
+
+	report_deviation("precision", "float", pr, cur, nv, opt->verbose);
+	if (fixed)
+		report_deviation("precision.finish", "float -f", fixed, cur, nv,
+				 opt->verbose);
+
+	// @ref is the caller's, free whichever buffer is ours
+	free(cur == ref ? next : cur);
+}
+
+// largest and total absolute deviation of @pr from @ref, and how many
+// ranks print differently with the %.7f of output(), as @key.* stats
+static void report_deviation(const char *key, const char *label,
+			     const double *pr, const double *ref, int nv,
+			     int verbose)
+{
+	double max_dev = 0;
+	double l1_dev = 0;
+	int changed = 0;
+	char a[32], b[32];
+	for (int i = 0; i < nv; i++) {
+		const double dev = fabs(pr[i] - ref[i]);
+		if (dev > max_dev) max_dev = dev;
+		l1_dev += dev;
+		snprintf(a, sizeof(a), "%.7f", pr[i]);
+		snprintf(b, sizeof(b), "%.7f", ref[i]);
+		changed += strcmp(a, b) != 0;
+	}
+	char name[64];
+	snprintf(name, sizeof(name), "%s.max_dev", key);
+	stats_set(name, max_dev);
+	snprintf(name, sizeof(name), "%s.l1_dev", key);
+	stats_set(name, l1_dev);
+	snprintf(name, sizeof(name), "%s.changed_7f", key);
+	stats_set(name, changed);
+	if (verbose)
+		printf("%s vs double: max deviation %.3g, L1 %.3g, "
+		       "%d of %d ranks print differently\n",
+		       label, max_dev, l1_dev, changed, nv);
+}
+
+/*
+ * partition - split urls [0, @nv), in-link offsets @off, into @n ranges
+ *
+ * Each url costs its number of in-edges plus one, so ranges carry about
+ * the same amount of work even when link counts are skewed.
+ */
+static int *partition(const int *off, int nv, int n)
+{
+	int *bound = malloc((n + 1) * sizeof(int));
+	if (bound == NULL) {
+		perror("malloc failed");
+		exit(EXIT_FAILURE);
+	}
+
+	const double total = (double)off[nv] + nv;
+	int v = 0;
+	bound[0] = 0;
+	for (int t = 1; t < n; t++) {
+		const double target = total * t / n;
+		while (v < nv && (double)off[v] + v < target)
+			v++;
+		bound[t] = v;
+	}
+	bound[n] = nv;
+
+	return bound;
+}
+
+/*
+ * get_weights - precompute Win(pj, pi) * Wout(pj, pi) for every edge
+ *
+ * Win = I(pi) / sum(I(pk)) and Wout = O(pi) / sum(O(pk)) where pk ranges
+ * over the pages pj links to, with 0.5 standing in for a zero out degree.
+ * The sums only depend on pj so they are computed once per page, which
+ * makes the whole pass O(V + E). The returned array is aligned with the
+ * in-edge lists, i.e. the weight of the j-th url in nodes_to(g, i) is at
+ * offset sum(indegree(g, k), k < i) + j.
+ */
+static double *get_weights(graph_t g)
+{
+	const int nv = nvertices(g);
+	double *in_sum = calloc(nv, sizeof(double));
+	double *out_sum = calloc(nv, sizeof(double));
+	double *w = malloc((nedges(g) + 1) * sizeof(double));
+	if (in_sum == NULL || out_sum == NULL || w == NULL) {
+		perror("malloc failed");
+		exit(EXIT_FAILURE);
+	}
+
+	for (int pj = 0; pj < nv; pj++) {
+		int size = 0;
+		const int *urls = nodes_from(g, pj, &size);
+		for (int k = 0; k < size; k++) {
+			double deg = outdegree(g, urls[k]);
+			in_sum[pj] += indegree(g, urls[k]);
+			out_sum[pj] += deg == 0 ? 0.5 : deg;
+		}
+	}
+
+	int e = 0;
+	for (int pi = 0; pi < nv; pi++) {
+		double in_deg = indegree(g, pi);
+		double out_deg = outdegree(g, pi);
+		out_deg = out_deg == 0 ? 0.5 : out_deg;
+
+		int size = 0;
+		const int *url_to = nodes_to(g, pi, &size);
+		for (int j = 0; j < size; j++, e++) {
+			int pj = url_to[j];
+			w[e] = in_deg / in_sum[pj] * (out_deg / out_sum[pj]);
+		}
 	}
-	free(urls);
 
-	return deg_pi / sum;
+	free(in_sum);
+	free(out_sum);
+	return w;
 }
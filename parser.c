@@ -1,104 +1,237 @@
 // parse text files
 
+// memmem is a GNU extension, mmap is POSIX
+#define _GNU_SOURCE
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
 #include <assert.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #include "parser.h"
+#include "stats.h"
 
 static void add_size(handle_t);
-static FILE *open_file(char *, char *);
-static handle_t new_handle(void);
+static handle_t map_file(char *);
+static void add_tok(handle_t, char *, char *);
+static char *next_line(handle_t, char *, char **);
+static int is_tag(char *, char *, char *);
+static char *find_line(handle_t, char *);
+static void read_section(handle_t, char *, char *);
 static char *str_lower(char *str);
 static void rmoccur(char *str, char c);
 
+// files smaller than this are read rather than mapped
+#define SMALL_FILE (64 * 1024)
+
+// a token is a slice of the mapped file, terminated in place with '\0'
+struct tok {
+	size_t off;
+	int len;
+};
+
+/*
+ * The whole file is mapped copy-on-write and tokens point straight into
+ * the mapping, so parsing does not allocate per line or per token. The
+ * byte after each token is overwritten with '\0' so getbuf can hand out
+ * plain C strings; one extra zero page after the end of the file makes
+ * room for the terminator of the last token. Small files are read into
+ * a single buffer instead, which is cheaper than mapping them.
+ */
 struct _handle {
 	int size;
 	int max_size;
-	char **buf;
+	struct tok *buf;
+	// @base, @len - the mapped file
+	// @map_len - length of the mapping, including the extra page,
+	// 0 if the file was small enough to be read into @base instead
+	char *base;
+	size_t len;
+	size_t map_len;
 };
 
-// function wrapper around fopen
-static FILE *open_file(char *path, char *mode)
+// map (or read) @path privately, exits if it cannot be opened
+static handle_t map_file(char *path)
 {
-	FILE *fp;
-	fp = fopen(path, mode);
+	int fd = open(path, O_RDONLY);
+	struct stat st;
 
-	if (fp == NULL) {
+	if (fd < 0 || fstat(fd, &st) != 0) {
 		perror("Failed to open file");
 		exit(EXIT_FAILURE);
 	}
 
-	return fp;
-}
-
-static handle_t new_handle(void)
-{
 	handle_t h = malloc(sizeof(struct _handle));
 	assert(h);
 	h->buf = NULL;
 	h->size = h->max_size = 0;
+	h->len = st.st_size;
+
+	// a couple of page faults and munmap cost more than reading a small
+	// file, so those are read into a buffer with room for the terminator
+	if (h->len < SMALL_FILE) {
+		h->map_len = 0;
+		h->base = malloc(h->len + 1);
+		assert(h->base);
+		size_t n = 0;
+		while (n < h->len) {
+			ssize_t r = read(fd, h->base + n, h->len - n);
+			if (r <= 0) {
+				perror("Failed to read file");
+				exit(EXIT_FAILURE);
+			}
+			n += r;
+		}
+		h->base[h->len] = '\0';
+		close(fd);
+		return h;
+	}
+
+	// reserve the file plus one zero page, then map the file over it
+	const size_t page = sysconf(_SC_PAGESIZE);
+	h->map_len = (h->len / page + 1) * page;
+	h->base = mmap(NULL, h->map_len, PROT_READ | PROT_WRITE,
+		       MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (h->base == MAP_FAILED) {
+		perror("mmap failed");
+		exit(EXIT_FAILURE);
+	}
+	if (h->len > 0 &&
+	    mmap(h->base, h->len, PROT_READ | PROT_WRITE,
+		 MAP_PRIVATE | MAP_FIXED, fd, 0) == MAP_FAILED) {
+		perror("mmap failed");
+		exit(EXIT_FAILURE);
+	}
+	close(fd);
 
 	return h;
 }
 
-handle_t parse(char *path)
+// record [@start, @end) as a token
+static void add_tok(handle_t h, char *start, char *end)
 {
-	FILE *fp = open_file(path, "r");
+	if (h->size >= h->max_size) add_size(h);
+	h->buf[h->size].off = start - h->base;
+	h->buf[h->size].len = end - start;
+	h->size++;
+	*end = '\0';
+}
 
-	handle_t h = new_handle();
-	// malloc buffer
-	add_size(h);
+handle_t parse(char *path)
+{
+	const double t = stats_start();
+	handle_t h = map_file(path);
+	char *p = h->base;
+	char *const end = h->base + h->len;
 
-	while (fscanf(fp, "%ms", &(h->buf[h->size])) != EOF) {
-		h->size++;
-		if (h->size >= h->max_size) add_size(h);
+	// whitespace separated words, like %s
+	while (p < end) {
+		while (p < end && isspace((unsigned char)*p)) p++;
+		char *start = p;
+		while (p < end && !isspace((unsigned char)*p)) p++;
+		if (p > start) add_tok(h, start, p++);
 	}
 
-	fclose(fp);
+	stats_stop("parse", t);
+	stats_count("parse_bytes", h->len);
 	return h;
 }
 
-handle_t parse_url(char *path, char *start_tag, char *end_tag)
+/*
+ * next_line - return the line starting at or after @p
+ *
+ * Leading whitespace (blank lines included) is skipped, as the
+ * "%m[^\n]\n" format used to, and the line runs up to, not including,
+ * the next '\n'. *@eol is set to the end of the line. Returns NULL at the
+ * end of the file.
+ */
+static char *next_line(handle_t h, char *p, char **eol)
 {
-	FILE *fp = open_file(path, "r");
+	char *const end = h->base + h->len;
+	while (p < end && isspace((unsigned char)*p)) p++;
+	if (p >= end)
+		return NULL;
 
-	handle_t h = new_handle();
-	// malloc buffer
-	add_size(h);
+	char *nl = memchr(p, '\n', end - p);
+	*eol = nl ? nl : end;
+	return p;
+}
 
-	char *buf;
-	int read_buf= 0;
+// check if line [@line, @eol) reads @tag
+static int is_tag(char *line, char *eol, char *tag)
+{
+	size_t n = strlen(tag);
+	return (size_t)(eol - line) == n && memcmp(line, tag, n) == 0;
+}
+
+// return the first line that reads @tag, NULL if there is none
+static char *find_line(handle_t h, char *tag)
+{
+	char *const end = h->base + h->len;
+	const size_t n = strlen(tag);
+	char *p = h->base;
+
+	while ((p = memmem(p, end - p, tag, n)) != NULL) {
+		// only whitespace may precede the tag on its line...
+		char *q = p;
+		while (q > h->base && q[-1] != '\n' && isspace((unsigned char)q[-1]))
+			q--;
+		// ...and nothing may follow it
+		int line_start = q == h->base || q[-1] == '\n';
+		if (line_start && (p + n == end || p[n] == '\n'))
+			return p;
+		p++;
+	}
+	return NULL;
+}
+
+handle_t parse_url(char *path, char *start_tag, char *end_tag)
+{
+	const double t = stats_start();
+	handle_t h = map_file(path);
+	read_section(h, start_tag, end_tag);
+	stats_stop("parse_url", t);
+	stats_count("parse_url_bytes", h->len);
+	return h;
+}
 
-	// %m[^\n]\n reads whole line until '\n' (not including \n)
-	while (fscanf(fp, "%m[^\n]\n", &buf) != EOF) {
-		if (strcmp(buf, end_tag) == 0) {
-			free(buf);
-			// break early to avoid more fscanf
+// tokenize the lines between @start_tag and @end_tag
+static void read_section(handle_t h, char *start_tag, char *end_tag)
+{
+	// jump straight to the section, unless it is closed before it opens
+	char *line = find_line(h, start_tag);
+	char *stop = find_line(h, end_tag);
+	if (line == NULL || (stop && stop < line))
+		return;
+
+	int read_buf = 0;
+	char *eol;
+	for (line = next_line(h, line, &eol); line;
+	     line = next_line(h, eol + 1, &eol)) {
+		if (is_tag(line, eol, end_tag))
 			break;
-		}
 		if (read_buf) {
 			// use space as delimiter
-			char *token = strtok(buf, " ");
-
-			while (token != NULL) {
-				h->buf[h->size] = malloc(strlen(token) + 1);
-				strcpy(h->buf[h->size], token);
-				h->size++;
-				if (h->size >= h->max_size) add_size(h);
-				token = strtok(NULL, " ");
+			char *p = line;
+			while (p < eol) {
+				while (p < eol && *p == ' ') p++;
+				char *start = p;
+				char *space = memchr(p, ' ', eol - p);
+				p = space ? space : eol;
+				if (p > start) add_tok(h, start, p);
+				p++;
 			}
 		}
-		// start reading next iteration
-		if (strcmp(buf, start_tag) == 0) read_buf = !read_buf;
-		free(buf);
+		// start reading next iteration; tokenizing ends the line at its
+		// first space, as strtok did, so a start tag inside the section
+		// is read as words and does not toggle
+		if (is_tag(line, eol, start_tag)) read_buf = !read_buf;
 	}
-
-	fclose(fp);
-	return h;
-
 }
 
 // doubles buf size
@@ -106,8 +239,8 @@ static void add_size(handle_t h)
 {
 	assert(h);
 	// doubles the original size
-	int new_size = h->size == 0 ? 1 : 2 * h->size;
-	char **tmp = realloc(h->buf, new_size * sizeof(char *));
+	int new_size = h->size == 0 ? 16 : 2 * h->size;
+	struct tok *tmp = realloc(h->buf, new_size * sizeof(struct tok));
 
 	if (tmp) {
 		h->buf = tmp;
@@ -121,8 +254,10 @@ static void add_size(handle_t h)
 void free_handle(handle_t h)
 {
 	assert(h);
-	for (int i = 0; i < h->size; i++)
-		free(h->buf[i]);
+	if (h->map_len)
+		munmap(h->base, h->map_len);
+	else
+		free(h->base);
 	free(h->buf);
 	free(h);
 }
@@ -131,13 +266,21 @@ void print_handle(handle_t h)
 {
 	assert(h);
 	for (int i = 0; i < h->size; i++)
-		printf("%s\n", h->buf[i]);
+		printf("%s\n", getbuf(h, i));
 }
 
+// token @id, a view into the mapped file valid until free_handle
 char *getbuf(handle_t h, int id)
 {
 	assert(h);
-	return h->buf[id];
+	return h->base + h->buf[id].off;
+}
+
+// length of token @id
+int buflen(handle_t h, int id)
+{
+	assert(h);
+	return h->buf[id].len;
 }
 
 int handle_size(handle_t h)
@@ -173,8 +316,10 @@ void normalise(handle_t h)
 	const char *rm = ".,;?";
 
 	for (int i = 0; i < h->size; i++) {
-		str_lower(h->buf[i]);
+		char *tok = getbuf(h, i);
+		str_lower(tok);
 		for (int j = 0; j < (int)strlen(rm); j++)
-			rmoccur(h->buf[i], rm[j]);
+			rmoccur(tok, rm[j]);
+		h->buf[i].len = strlen(tok);
 	}
 }
@@ -8,6 +8,7 @@ handle_t parse_url(char *, char *start_tag, char *end_tag);
 void free_handle(handle_t);
 void print_handle(handle_t);
 char *getbuf(handle_t h, int id);
+int buflen(handle_t h, int id);
 int handle_size(handle_t);
 void normalise(handle_t);
 
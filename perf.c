@@ -0,0 +1,220 @@
+// hardware performance counters through perf_event_open
+
+// syscall is not POSIX
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+
+#include "perf.h"
+#include "stats.h"
+
+// macro for dumping error messages
+#ifndef DUMP_ERR
+#define DUMP_ERR(ptr, str)				\
+	if (ptr == NULL) {				\
+		perror(str);				\
+		exit(EXIT_FAILURE);			\
+	}
+#endif
+
+#ifdef __linux__
+
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+#define NEVENT 5
+// distinct phase names, extra phases are dropped
+#define MAX_PHASES 16
+
+// read misses of cache @c
+#define CACHE_MISSES(c)							\
+	(PERF_COUNT_HW_CACHE_##c |					\
+	 PERF_COUNT_HW_CACHE_OP_READ << 8 |				\
+	 PERF_COUNT_HW_CACHE_RESULT_MISS << 16)
+
+static const struct {
+	const char *name;
+	uint32_t type;
+	uint64_t config;
+} events[NEVENT] = {
+	{ "cycles", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+	{ "instructions", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+	{ "llc_misses", PERF_TYPE_HW_CACHE, CACHE_MISSES(LL) },
+	{ "dtlb_misses", PERF_TYPE_HW_CACHE, CACHE_MISSES(DTLB) },
+	{ "branch_misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES },
+};
+
+// one read of a counter, see PERF_FORMAT_TOTAL_TIME_*
+struct reading {
+	uint64_t value;
+	uint64_t enabled;
+	uint64_t running;
+};
+
+struct phase {
+	char *name;
+	long units;
+	double count[NEVENT];
+};
+
+struct _perf {
+	// @fd - counter of each event, -1 if it could not be opened
+	// @start - readings taken by perf_start
+	int fd[NEVENT];
+	struct reading start[NEVENT];
+	struct phase phase[MAX_PHASES];
+	int nphase;
+};
+
+static int read_counter(int fd, struct reading *r)
+{
+	return read(fd, r, sizeof(*r)) == sizeof(*r) ? 0 : -1;
+}
+
+/*
+ * new_perf - open the counters for this process
+ *
+ * Only user space is counted, which perf_event_paranoid up to 2 allows.
+ * The counters run from here on; phases take differences of readings,
+ * scaled up when the kernel had to multiplex them.
+ */
+perf_t new_perf(void)
+{
+	perf_t p = calloc(1, sizeof(struct _perf));
+	DUMP_ERR(p, "calloc failed");
+
+	int nopen = 0;
+	int err = 0;
+	for (int e = 0; e < NEVENT; e++) {
+		struct perf_event_attr attr;
+		memset(&attr, 0, sizeof(attr));
+		attr.size = sizeof(attr);
+		attr.type = events[e].type;
+		attr.config = events[e].config;
+		attr.inherit = 1;
+		attr.exclude_kernel = 1;
+		attr.exclude_hv = 1;
+		attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED |
+			PERF_FORMAT_TOTAL_TIME_RUNNING;
+		p->fd[e] = syscall(SYS_perf_event_open, &attr, 0, -1, -1,
+				   PERF_FLAG_FD_CLOEXEC);
+		if (p->fd[e] < 0)
+			err = errno;
+		else
+			nopen++;
+	}
+
+	if (nopen == 0) {
+		fprintf(stderr, "perf counters unavailable: %s\n", strerror(err));
+		free(p);
+		return NULL;
+	}
+	return p;
+}
+
+// start a phase
+void perf_start(perf_t p)
+{
+	if (p == NULL) return;
+	for (int e = 0; e < NEVENT; e++)
+		if (p->fd[e] >= 0 && read_counter(p->fd[e], &p->start[e]) != 0)
+			p->start[e].running = UINT64_MAX;
+}
+
+static struct phase *find_phase(perf_t p, const char *name)
+{
+	for (int i = 0; i < p->nphase; i++)
+		if (strcmp(p->phase[i].name, name) == 0)
+			return &p->phase[i];
+	if (p->nphase == MAX_PHASES)
+		return NULL;
+	struct phase *ph = &p->phase[p->nphase++];
+	memset(ph, 0, sizeof(*ph));
+	ph->name = strdup(name);
+	DUMP_ERR(ph->name, "strdup failed");
+	return ph;
+}
+
+/*
+ * perf_stop - end the phase started last
+ * @p: counters
+ * @name: phase the counts are added to
+ * @unit: what @units counts, names the rates
+ * @units: work done in the phase
+ *
+ * Sets <name>.<event>, <name>.<event>_per_<unit>, <name>.<unit>s and,
+ * with cycles and instructions, <name>.ipc to the phase's totals so far.
+ */
+void perf_stop(perf_t p, const char *name, const char *unit, long units)
+{
+	if (p == NULL) return;
+	struct phase *ph = find_phase(p, name);
+	if (ph == NULL) return;
+	ph->units += units;
+
+	char key[128];
+	for (int e = 0; e < NEVENT; e++) {
+		struct reading r;
+		const struct reading *s = &p->start[e];
+		if (p->fd[e] < 0 || read_counter(p->fd[e], &r) != 0 ||
+		    s->running == UINT64_MAX)
+			continue;
+		// never scheduled, nothing to scale
+		if (r.running == s->running) continue;
+		ph->count[e] += (double)(r.value - s->value) *
+			(r.enabled - s->enabled) / (r.running - s->running);
+
+		snprintf(key, sizeof(key), "%s.%s", name, events[e].name);
+		stats_set(key, ph->count[e]);
+		if (ph->units > 0) {
+			snprintf(key, sizeof(key), "%s.%s_per_%s", name,
+				 events[e].name, unit);
+			stats_set(key, ph->count[e] / ph->units);
+		}
+	}
+	snprintf(key, sizeof(key), "%s.%ss", name, unit);
+	stats_set(key, ph->units);
+	if (ph->count[0] > 0 && ph->count[1] > 0) {
+		snprintf(key, sizeof(key), "%s.ipc", name);
+		stats_set(key, ph->count[1] / ph->count[0]);
+	}
+}
+
+void free_perf(perf_t p)
+{
+	if (p == NULL) return;
+	for (int e = 0; e < NEVENT; e++)
+		if (p->fd[e] >= 0) close(p->fd[e]);
+	for (int i = 0; i < p->nphase; i++)
+		free(p->phase[i].name);
+	free(p);
+}
+
+#else
+
+// no perf_event_open, every phase is a no-op
+
+perf_t new_perf(void)
+{
+	fprintf(stderr, "perf counters unavailable: not supported\n");
+	return NULL;
+}
+
+void perf_start(perf_t p)
+{
+}
+
+void perf_stop(perf_t p, const char *name, const char *unit, long units)
+{
+}
+
+void free_perf(perf_t p)
+{
+}
+
+#endif
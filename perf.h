@@ -0,0 +1,27 @@
+// perf.h ... Interface to hardware performance counters
+//
+// Counts cycles, instructions, LLC misses, dTLB misses and branch misses
+// of the process over named phases with perf_event_open, and adds the
+// totals and their rate per unit of work (edge, posting, ...) to the
+// stats report as values:
+//
+//	perf_start(p);
+//	...
+//	perf_stop(p, "iterate", "edge", edges);
+//
+// gives iterate.cycles, iterate.cycles_per_edge, and so on. Counters
+// the kernel or the hardware refuses are left out; if none can be
+// opened new_perf returns NULL, and every call takes NULL as a no-op.
+// Threads created after new_perf are counted too.
+
+#ifndef PERF_H
+#define PERF_H
+
+typedef struct _perf *perf_t;
+
+perf_t new_perf(void);
+void perf_start(perf_t);
+void perf_stop(perf_t, const char *, const char *, long);
+void free_perf(perf_t);
+
+#endif
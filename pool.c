@@ -0,0 +1,155 @@
+// fork-join thread pool on top of pthreads
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <assert.h>
+#include <pthread.h>
+
+#include "pool.h"
+
+// macro for dumping error messages
+#ifndef DUMP_ERR
+#define DUMP_ERR(ptr, str)				\
+	if (ptr == NULL) {				\
+		perror(str);				\
+		exit(EXIT_FAILURE);			\
+	}
+#endif
+
+// worker argument: the pool and the worker's thread id
+struct worker {
+	pool_t p;
+	int id;
+};
+
+struct _pool {
+	// @n - number of threads, including the caller
+	// @gen - bumped every time a task is handed out
+	// @pending - workers still running the current task
+	// @quit - set by free_pool to stop the workers
+	int n;
+	unsigned gen;
+	int pending;
+	int quit;
+	task_fn fn;
+	void *arg;
+	pthread_mutex_t lock;
+	pthread_cond_t start;
+	pthread_cond_t done;
+	pthread_t *tid;
+	struct worker *w;
+};
+
+static void *worker_main(void *);
+
+pool_t new_pool(int n)
+{
+	assert(n > 0);
+	pool_t p = malloc(sizeof(struct _pool));
+	DUMP_ERR(p, "malloc failed");
+
+	p->n = n;
+	p->gen = 0;
+	p->pending = 0;
+	p->quit = 0;
+	p->fn = NULL;
+	p->arg = NULL;
+	pthread_mutex_init(&p->lock, NULL);
+	pthread_cond_init(&p->start, NULL);
+	pthread_cond_init(&p->done, NULL);
+
+	p->tid = malloc(n * sizeof(pthread_t));
+	p->w = malloc(n * sizeof(struct worker));
+	DUMP_ERR(p->tid, "malloc failed");
+	DUMP_ERR(p->w, "malloc failed");
+
+	// thread 0 is the caller of pool_run
+	for (int i = 1; i < n; i++) {
+		p->w[i].p = p;
+		p->w[i].id = i;
+		if (pthread_create(&p->tid[i], NULL, worker_main, &p->w[i]) != 0) {
+			perror("pthread_create failed");
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	return p;
+}
+
+static void *worker_main(void *arg)
+{
+	struct worker *w = arg;
+	pool_t p = w->p;
+	unsigned seen = 0;
+
+	pthread_mutex_lock(&p->lock);
+	for (;;) {
+		while (p->gen == seen && !p->quit)
+			pthread_cond_wait(&p->start, &p->lock);
+		if (p->quit) break;
+		seen = p->gen;
+		task_fn fn = p->fn;
+		void *targ = p->arg;
+		pthread_mutex_unlock(&p->lock);
+
+		fn(targ, w->id, p->n);
+
+		pthread_mutex_lock(&p->lock);
+		if (--p->pending == 0)
+			pthread_cond_signal(&p->done);
+	}
+	pthread_mutex_unlock(&p->lock);
+
+	return NULL;
+}
+
+// run @fn on every thread of the pool and wait for all of them
+void pool_run(pool_t p, task_fn fn, void *arg)
+{
+	assert(p && fn);
+	if (p->n == 1) {
+		fn(arg, 0, 1);
+		return;
+	}
+
+	pthread_mutex_lock(&p->lock);
+	p->fn = fn;
+	p->arg = arg;
+	p->pending = p->n - 1;
+	p->gen++;
+	pthread_cond_broadcast(&p->start);
+	pthread_mutex_unlock(&p->lock);
+
+	fn(arg, 0, p->n);
+
+	pthread_mutex_lock(&p->lock);
+	while (p->pending > 0)
+		pthread_cond_wait(&p->done, &p->lock);
+	pthread_mutex_unlock(&p->lock);
+}
+
+int pool_size(pool_t p)
+{
+	assert(p);
+	return p->n;
+}
+
+void free_pool(pool_t p)
+{
+	if (p == NULL) return;
+
+	pthread_mutex_lock(&p->lock);
+	p->quit = 1;
+	pthread_cond_broadcast(&p->start);
+	pthread_mutex_unlock(&p->lock);
+
+	for (int i = 1; i < p->n; i++)
+		pthread_join(p->tid[i], NULL);
+
+	pthread_mutex_destroy(&p->lock);
+	pthread_cond_destroy(&p->start);
+	pthread_cond_destroy(&p->done);
+	free(p->tid);
+	free(p->w);
+	free(p);
+}
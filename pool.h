@@ -0,0 +1,20 @@
+// pool.h ... Interface to a fixed size fork-join thread pool
+//
+// pool_run hands the same task to every thread of the pool and returns
+// once all of them are done. The calling thread takes part as thread 0,
+// so a pool of one thread never spawns anything.
+
+#ifndef POOL_H
+#define POOL_H
+
+typedef struct _pool *pool_t;
+
+// task run by each thread, @id in [0, @n)
+typedef void (*task_fn)(void *arg, int id, int n);
+
+pool_t new_pool(int);
+void pool_run(pool_t, task_fn, void *);
+int pool_size(pool_t);
+void free_pool(pool_t);
+
+#endif
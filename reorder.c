@@ -0,0 +1,375 @@
+// vertex orders that put urls read together next to each other
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#include "reorder.h"
+
+// macro for dumping error messages
+#ifndef DUMP_ERR
+#define DUMP_ERR(ptr, str)				\
+	if (ptr == NULL) {				\
+		perror(str);				\
+		exit(EXIT_FAILURE);			\
+	}
+#endif
+
+// urls placed before the next one that gorder compares it with
+#define GORDER_WINDOW 5
+// sources with more out-links than this are not used to find siblings
+#define GORDER_HUB 16
+
+static int *order_degree(graph_t, int);
+static int *order_rcm(graph_t, int);
+static int *order_gorder(graph_t, int);
+
+static const order_t orders[] = {
+	{ "degree", order_degree },
+	{ "rcm", order_rcm },
+	{ "gorder", order_gorder },
+};
+
+#define NORDERS (int)(sizeof(orders) / sizeof(orders[0]))
+
+// order called @name, NULL if it does not exist
+const order_t *find_order(const char *name)
+{
+	for (int i = 0; i < NORDERS; i++)
+		if (strcmp(orders[i].name, name) == 0)
+			return &orders[i];
+	return NULL;
+}
+
+static int *new_ids(int n)
+{
+	int *ids = malloc(((size_t)n + 1) * sizeof(int));
+	DUMP_ERR(ids, "malloc failed");
+	return ids;
+}
+
+// out-links of @v to urls in [0, @nv)
+static int out_count(const int *out_off, const int *out_adj, int v, int nv)
+{
+	int n = 0;
+	for (int e = out_off[v]; e < out_off[v + 1]; e++)
+		n += out_adj[e] < nv;
+	return n;
+}
+
+/*
+ * order_degree - urls by out-degree, highest first
+ *
+ * The rank of a url is read once per out-link, so the few urls most
+ * links come from end up sharing a handful of cache lines. A counting
+ * sort keeps urls of equal degree in their original order.
+ */
+static int *order_degree(graph_t g, int nv)
+{
+	const int *out_off = out_offsets(g);
+	const int *out_adj = out_links(g);
+	int *deg = new_ids(nv);
+	int max = 0;
+	for (int v = 0; v < nv; v++) {
+		deg[v] = out_count(out_off, out_adj, v, nv);
+		if (deg[v] > max) max = deg[v];
+	}
+
+	int *start = calloc((size_t)max + 2, sizeof(int));
+	DUMP_ERR(start, "calloc failed");
+	for (int v = 0; v < nv; v++)
+		start[max - deg[v] + 1]++;
+	for (int d = 1; d <= max + 1; d++)
+		start[d] += start[d - 1];
+
+	int *perm = new_ids(nv);
+	for (int v = 0; v < nv; v++)
+		perm[start[max - deg[v]]++] = v;
+
+	free(start);
+	free(deg);
+	return perm;
+}
+
+struct vdeg {
+	int deg;
+	int v;
+};
+
+int _vdeg_cmp(const void *a, const void *b)
+{
+	const struct vdeg *x = a;
+	const struct vdeg *y = b;
+	if (x->deg != y->deg) return x->deg < y->deg ? -1 : 1;
+	return (x->v > y->v) - (x->v < y->v);
+}
+
+/*
+ * order_rcm - reverse Cuthill-McKee
+ *
+ * Breadth first search over the links taken in both directions, each
+ * component started from its lowest degree url and the neighbours of
+ * every url queued by increasing degree; the visit order is reversed.
+ * Linked urls end up close together, which narrows the band the in-link
+ * reads of consecutive urls fall in.
+ */
+static int *order_rcm(graph_t g, int nv)
+{
+	const int *in_off = in_offsets(g);
+	const int *in_adj = in_links(g);
+	const int *out_off = out_offsets(g);
+	const int *out_adj = out_links(g);
+
+	// every url by degree, lowest first, to pick the starts from
+	struct vdeg *by_deg = malloc(((size_t)nv + 1) * sizeof(struct vdeg));
+	int *deg = new_ids(nv);
+	char *seen = calloc((size_t)nv + 1, sizeof(char));
+	DUMP_ERR(by_deg, "malloc failed");
+	DUMP_ERR(seen, "calloc failed");
+	int max = 0;
+	for (int v = 0; v < nv; v++) {
+		deg[v] = in_off[v + 1] - in_off[v] +
+			out_count(out_off, out_adj, v, nv);
+		if (deg[v] > max) max = deg[v];
+		by_deg[v] = (struct vdeg){ deg[v], v };
+	}
+	qsort(by_deg, nv, sizeof(struct vdeg), _vdeg_cmp);
+
+	// neighbours of one url, at most all of its links
+	struct vdeg *next = malloc(((size_t)max + 1) * sizeof(struct vdeg));
+	DUMP_ERR(next, "malloc failed");
+
+	// @order doubles as the bfs queue
+	int *order = new_ids(nv);
+	int tail = 0;
+	for (int s = 0; s < nv; s++) {
+		if (seen[by_deg[s].v]) continue;
+		seen[by_deg[s].v] = 1;
+		int head = tail;
+		order[tail++] = by_deg[s].v;
+		while (head < tail) {
+			const int v = order[head++];
+			int n = 0;
+			for (int e = in_off[v]; e < in_off[v + 1]; e++) {
+				const int u = in_adj[e];
+				if (u < nv && !seen[u]) {
+					seen[u] = 1;
+					next[n++] = (struct vdeg){ deg[u], u };
+				}
+			}
+			for (int e = out_off[v]; e < out_off[v + 1]; e++) {
+				const int u = out_adj[e];
+				if (u < nv && !seen[u]) {
+					seen[u] = 1;
+					next[n++] = (struct vdeg){ deg[u], u };
+				}
+			}
+			qsort(next, n, sizeof(struct vdeg), _vdeg_cmp);
+			for (int i = 0; i < n; i++)
+				order[tail++] = next[i].v;
+		}
+	}
+
+	int *perm = new_ids(nv);
+	for (int i = 0; i < nv; i++)
+		perm[i] = order[nv - 1 - i];
+
+	free(order);
+	free(next);
+	free(seen);
+	free(deg);
+	free(by_deg);
+	return perm;
+}
+
+/*
+ * Unplaced urls bucketed by gorder score. Scores only ever move by one,
+ * so moving a url between neighbouring buckets is O(1) and the highest
+ * non-empty bucket is found by stepping down from the last one used.
+ * The fields of a url share a cache line, most updates touch just it
+ * and the head of its bucket.
+ */
+struct node {
+	int score;
+	int next;	// next url in the same bucket, -1 at the end
+	int prev;	// previous url in the bucket, -1 at its head
+	int placed;
+};
+
+struct queue {
+	struct node *node;
+	int *head;	// first url of each bucket, -1 if empty
+	int nhead;
+	int top;	// no url scores more than this
+};
+
+static void unlink_url(struct queue *q, int v)
+{
+	const struct node *n = &q->node[v];
+	if (n->prev >= 0)
+		q->node[n->prev].next = n->next;
+	else
+		q->head[n->score] = n->next;
+	if (n->next >= 0)
+		q->node[n->next].prev = n->prev;
+}
+
+static void link_url(struct queue *q, int v)
+{
+	struct node *n = &q->node[v];
+	const int s = n->score;
+	if (s == q->nhead) {
+		int *tmp = realloc(q->head, 2 * q->nhead * sizeof(int));
+		DUMP_ERR(tmp, "realloc failed");
+		q->head = tmp;
+		for (int i = q->nhead; i < 2 * q->nhead; i++)
+			q->head[i] = -1;
+		q->nhead *= 2;
+	}
+	n->prev = -1;
+	n->next = q->head[s];
+	if (q->head[s] >= 0)
+		q->node[q->head[s]].prev = v;
+	q->head[s] = v;
+	if (s > q->top) q->top = s;
+}
+
+// add @delta, +1 or -1, to the score of @v if it is not placed yet
+static void bump(struct queue *q, int v, int delta)
+{
+	if (q->node[v].placed) return;
+	unlink_url(q, v);
+	q->node[v].score += delta;
+	link_url(q, v);
+}
+
+static void place(struct queue *q, int v)
+{
+	unlink_url(q, v);
+	q->node[v].placed = 1;
+}
+
+// unplaced url with the highest score
+static int best(struct queue *q)
+{
+	while (q->head[q->top] < 0)
+		q->top--;
+	return q->head[q->top];
+}
+
+/*
+ * gorder_update - add @delta to the score of every url related to @u
+ *
+ * Urls linked with @u score one per link, and urls sharing an in-link
+ * source with it one per shared source. Sources with more than
+ * GORDER_HUB out-links are skipped for the latter: they tie together
+ * too many urls to say much, and each shared source costs one update
+ * per out-link, which is what the whole pass spends its time on.
+ */
+static void gorder_update(graph_t g, struct queue *q, int u, int delta,
+			  int nv)
+{
+	const int *in_off = in_offsets(g);
+	const int *in_adj = in_links(g);
+	const int *out_off = out_offsets(g);
+	const int *out_adj = out_links(g);
+
+	for (int e = out_off[u]; e < out_off[u + 1]; e++)
+		if (out_adj[e] < nv)
+			bump(q, out_adj[e], delta);
+	for (int e = in_off[u]; e < in_off[u + 1]; e++) {
+		const int x = in_adj[e];
+		if (x >= nv) continue;
+		bump(q, x, delta);
+		if (out_off[x + 1] - out_off[x] > GORDER_HUB) continue;
+		for (int f = out_off[x]; f < out_off[x + 1]; f++)
+			if (out_adj[f] < nv && out_adj[f] != u)
+				bump(q, out_adj[f], delta);
+	}
+}
+
+/*
+ * order_gorder - greedy Gorder
+ *
+ * Starting from the url with the most in-links, always place next the
+ * url with the highest score against the last GORDER_WINDOW placed (see
+ * gorder_update); scores are kept current as urls enter and leave the
+ * window. O(V + E * GORDER_HUB).
+ */
+static int *order_gorder(graph_t g, int nv)
+{
+	const int *in_off = in_offsets(g);
+	struct queue q = {
+		.node = calloc((size_t)nv + 1, sizeof(struct node)),
+		.head = new_ids(16),
+		.nhead = 16,
+	};
+	DUMP_ERR(q.node, "calloc failed");
+	for (int i = 0; i < q.nhead; i++)
+		q.head[i] = -1;
+	// linked in reverse, so urls that never score come out in id order
+	for (int v = nv - 1; v >= 0; v--)
+		link_url(&q, v);
+
+	int first = 0;
+	for (int v = 1; v < nv; v++)
+		if (in_off[v + 1] - in_off[v] > in_off[first + 1] - in_off[first])
+			first = v;
+
+	int *perm = new_ids(nv);
+	for (int k = 0; k < nv; k++) {
+		const int v = k == 0 ? first : best(&q);
+		place(&q, v);
+		perm[k] = v;
+		gorder_update(g, &q, v, 1, nv);
+		if (k >= GORDER_WINDOW)
+			gorder_update(g, &q, perm[k - GORDER_WINDOW], -1, nv);
+	}
+
+	free(q.node);
+	free(q.head);
+	return perm;
+}
+
+/*
+ * permute_links - relabel in-link arrays by @perm
+ * @off, @adj, @w: in-links of urls [0, @nv) and their weights
+ * @perm: new id -> old id
+ * @poff, @padj, @pw: relabelled arrays, sized like the originals
+ *
+ * Row i of the result is row perm[i] of the input with every in-link
+ * renamed. The links of a row keep their order, so rank sums are added
+ * up exactly as before. @w and @pw may be NULL to relabel the links only.
+ */
+void permute_links(const int *off, const int *adj, const double *w,
+		   const int *perm, int nv, int *poff, int *padj, double *pw)
+{
+	int *inv = new_ids(nv);
+	for (int i = 0; i < nv; i++)
+		inv[perm[i]] = i;
+
+	poff[0] = 0;
+	for (int i = 0; i < nv; i++) {
+		const int v = perm[i];
+		int k = poff[i];
+		for (int e = off[v]; e < off[v + 1]; e++, k++) {
+			padj[k] = inv[adj[e]];
+			if (w)
+				pw[k] = w[e];
+		}
+		poff[i + 1] = k;
+	}
+	free(inv);
+}
+
+// mean log2(1 + |i - j|) over the in-links j of every url i, a rough
+// measure of how far apart the ranks one url reads lie
+double log_gap(const int *off, const int *adj, int nv)
+{
+	double sum = 0;
+	for (int i = 0; i < nv; i++)
+		for (int e = off[i]; e < off[i + 1]; e++)
+			sum += log2(1 + abs(i - adj[e]));
+	return off[nv] ? sum / off[nv] : 0;
+}
@@ -0,0 +1,31 @@
+// reorder.h ... Interface to locality improving vertex orders
+//
+// The PageRank pull loop reads the rank of every in-link of a url, so
+// urls whose ranks are read together should sit close in memory. An
+// order is a permutation of the first @nv vertices of a graph, given as
+// new id -> vertex id; the rank loop runs on relabelled in-link arrays
+// and the ranks are mapped back when it is done.
+//
+//	degree	most linked-from urls first (hub sort)
+//	rcm	reverse Cuthill-McKee over the links in either direction
+//	gorder	greedy Gorder, each url placed next shares the most links
+//		and in-link sources with the last few placed
+
+#ifndef REORDER_H
+#define REORDER_H
+
+#include "graph.h"
+
+typedef int *(*order_fn)(graph_t, int);
+
+typedef struct {
+	const char *name;
+	order_fn order;
+} order_t;
+
+const order_t *find_order(const char *);
+void permute_links(const int *off, const int *adj, const double *w,
+		   const int *perm, int nv, int *poff, int *padj, double *pw);
+double log_gap(const int *off, const int *adj, int nv);
+
+#endif
@@ -1,138 +1,220 @@
+// getopt is POSIX
+#define _POSIX_C_SOURCE 200809L
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
+#include <unistd.h>
+#include <getopt.h>
 
 #include "invindex.h"
-#include "urltable.h"
-
-// pagerank struct
-typedef struct _pr {
-	char *url;
-	double pr;
-} pr_t;
-
-static int count_lines(FILE *f);
-static pr_t *parse_pr(char *path, int *size);
-static void free_pr(pr_t *arr, int size);
-static void print_sorted_pr(pr_t *, int, url_t *, int);
+#include "match.h"
+#include "topk.h"
+#include "serve.h"
+#include "stats.h"
+#include "perf.h"
+
+// everything a query needs, loaded once
+struct engine {
+	invindex_t in;
+	double *pr;	// pagerank of each doc
+	int *rank_of;	// line of each doc in pagerankList.txt, -1 if absent
+	int limit;	// maximum number of results
+	perf_t perf;	// hardware counters, NULL if off
+};
+
+static void load_ranks(struct engine *, char *);
+static void search(void *, int, char **, FILE *);
 static char *str_lower(char *str);
 
 int main(int argc, char **argv)
 {
-	if (argc < 2) {
-		fprintf(stderr, "Usage: %s [search_terms]\n", argv[0]);
+	int from_stdin = 0;
+	char *sock = NULL;
+	int limit = 30;
+	// --stats[=file], dumps timings as JSON to @stats_path or stderr;
+	// --perf adds hardware counters to them
+	static const struct option longopts[] = {
+		{ "stats", optional_argument, NULL, 'S' },
+		{ "perf", no_argument, NULL, 'P' },
+		{ NULL, 0, NULL, 0 }
+	};
+	char *stats_path = NULL;
+	int perf = 0;
+	int c;
+
+	while ((c = getopt_long(argc, argv, "n:ds:", longopts, NULL)) != -1) {
+		switch (c) {
+		case 'S':
+			stats_enable();
+			stats_path = optarg;
+			break;
+		case 'P':
+			perf = 1;
+			break;
+		case 'n':
+			limit = atoi(optarg);
+			break;
+		case 'd':
+			from_stdin = 1;
+			break;
+		case 's':
+			sock = optarg;
+			break;
+		default:
+			argc = 0;
+		}
+	}
+
+	const int server = from_stdin || sock;
+	if (argc == 0 || limit < 0 || (!server && optind >= argc) ||
+	    (server && optind < argc)) {
+		fprintf(stderr, "Usage: %s [-n results] [--stats[=file]] [--perf] "
+			"[-d | -s socket | search_terms]\n", argv[0]);
 		exit(EXIT_FAILURE);
 	}
 
-	int nquery = argc - 1;
-	char **query = &argv[1];
+	struct engine e;
+	if (perf) stats_enable();
+	e.perf = perf ? new_perf() : NULL;
+	// prefer the binary index written by inverted, it only decodes the
+	// query terms
+	doctab_t docs = NULL;
+	double t = stats_start();
+	e.in = map_index("invertedIndex.bin", NULL);
+	if (e.in == NULL) {
+		docs = read_doctab("collection.txt");
+		e.in = read_index("invertedIndex.txt", docs, NULL);
+	}
+	stats_stop("load_index", t);
+	t = stats_start();
+	load_ranks(&e, "pagerankList.txt");
+	stats_stop("load_ranks", t);
+	e.limit = limit;
+
+	// -d answers queries from stdin, -s from clients of a socket
+	if (sock)
+		serve_socket(sock, search, &e);
+	else if (from_stdin)
+		serve_stream(stdin, stdout, search, &e);
+	else
+		search(&e, argc - optind, &argv[optind], stdout);
+
+	free(e.rank_of);
+	free(e.pr);
+	free_index(e.in);
+	free_doctab(docs);
+	if (stats_enabled())
+		stats_save(stats_path);
+	free_perf(e.perf);
+	return 0;
+}
+
+// print the urls matching the most of the @nquery terms of @query
+static void search(void *arg, int nquery, char **query, FILE *out)
+{
+	struct engine *e = arg;
 
 	// normalise words
 	for (int i = 0; i < nquery; i++)
 		str_lower(query[i]);
 
-	invindex_t in = read_index("invertedIndex.txt");
-	urltable_t t = new_table(nquery);
-
-	for (int i = 0; i < nquery; i++) {
-		int row_size = 0;
-		char **urls = url_for(in, query[i], &row_size);
-		// batch insert url
-		if (urls)
-			insert_many(t, i, urls, row_size);
-		else
-			nquery--;
+	const unsigned **lists = malloc((nquery + 1) * sizeof(unsigned *));
+	int *sizes = malloc((nquery + 1) * sizeof(int));
+	if (lists == NULL || sizes == NULL) {
+		perror("malloc failed");
+		exit(EXIT_FAILURE);
 	}
-	set_count(t);
-
-	int urlsize = 0;
-	// merge table rows into one array
-	url_t *url = table_to_arr(t, &urlsize);
-	int pr_size = 0;
-	pr_t *pr = parse_pr("pagerankList.txt", &pr_size);
-
-	for (int i = nquery; i > 0; i--) {
-		int subarr_size = 0;
-		url_t *subarr = partition_arr(url, urlsize, i, &subarr_size);
-		print_sorted_pr(pr, pr_size, subarr, subarr_size);
-		free(subarr);
+	perf_start(e->perf);
+	double t = stats_start();
+	long npostings = 0;
+	for (int i = 0; i < nquery; i++) {
+		lists[i] = docs_for(e->in, query[i], &sizes[i]);
+		npostings += sizes[i];
 	}
-
-	free_pr(pr, pr_size);
-	free_table_arr(url, urlsize);
-	free_table(t);
-	free_index(in);
-	return 0;
-}
-
-static void print_sorted_pr(pr_t *arr, int arr_size, url_t *url, int urlsize)
-{
-	static int line_count = 0;
-	for (int i = 0; i < arr_size; i++) {
-		if (line_count < 30 && in_arr(url, urlsize, arr[i].url)) {
-			printf("%s\n", arr[i].url);
-			line_count++;
-		}
+	stats_stop("lookup", t);
+	stats_count("queries", 1);
+	stats_count("postings", npostings);
+
+	// docs with the number of terms they match
+	int nmatch = 0;
+	t = stats_start();
+	match_t *match = merge_postings(lists, NULL, sizes, nquery, &nmatch);
+	stats_stop("merge_postings", t);
+	stats_count("candidates", nmatch);
+	perf_stop(e->perf, "match", "posting", npostings);
+
+	// rank by match count then pagerank; pagerankList.txt is in rank
+	// order, so its line breaks ties
+	t = stats_start();
+	perf_start(e->perf);
+	topk_t top = new_topk(e->limit);
+	for (int i = 0; i < nmatch; i++) {
+		const unsigned doc = match[i].doc;
+		// docs missing from the ranking are never listed
+		if (e->rank_of[doc] < 0) continue;
+		hit_t h = { doc, match[i].count, e->pr[doc], e->rank_of[doc] };
+		topk_add(top, h);
 	}
-}
 
-// count number of lines in file
-static int count_lines(FILE *f)
-{
-	int lines = 0;
-	char ch;
-	while ((ch = fgetc(f)) != EOF)
-		if (ch == '\n')
-			lines++;
-	// reset file pointer back to the start
-	fseek(f, 0, SEEK_SET);
-	return lines;
+	int nhit = 0;
+	hit_t *hit = topk_results(top, &nhit);
+	perf_stop(e->perf, "score", "candidate", nmatch);
+	for (int i = 0; i < nhit; i++)
+		fprintf(out, "%s\n", index_url(e->in, hit[i].id));
+
+	free_topk(top);
+	stats_stop("rank", t);
+	free(match);
+	free(sizes);
+	free(lists);
 }
 
-static pr_t *parse_pr(char *path, int *size)
+/*
+ * load_ranks - read pagerankList.txt into arrays indexed by doc id
+ *
+ * Each line is "url, outdegree, pagerank". The file is read once, line
+ * by line, and urls the index does not know are skipped, so a search
+ * looks a doc's rank up directly.
+ */
+static void load_ranks(struct engine *e, char *path)
 {
-	FILE *fp;
-	fp = fopen(path, "r");
-
+	FILE *fp = fopen(path, "r");
 	if (fp == NULL) {
 		perror("Failed to open file");
 		exit(EXIT_FAILURE);
 	}
 
-	*size = count_lines(fp);
-	pr_t *arr = malloc((*size + 1) * sizeof(pr_t));
-
-	if (arr == NULL) {
+	const int n = index_ndocs(e->in);
+	e->pr = calloc(n + 1, sizeof(double));
+	e->rank_of = malloc((n + 1) * sizeof(int));
+	if (e->pr == NULL || e->rank_of == NULL) {
 		perror("malloc failed");
 		exit(EXIT_FAILURE);
 	}
-
-	for (int i = 0; i < *size; i++) {
-		arr[i].url = NULL;
-		arr[i].pr = 0;
+	for (int i = 0; i < n; i++)
+		e->rank_of[i] = -1;
+
+	char *line = NULL;
+	size_t cap = 0;
+	int lineno = 0;
+	while (getline(&line, &cap, fp) != -1) {
+		char *comma = strchr(line, ',');
+		char *pr = comma ? strchr(comma + 1, ',') : NULL;
+		if (pr == NULL) continue;
+		*comma = '\0';
+
+		int doc = index_doc(e->in, line);
+		if (doc >= 0 && e->rank_of[doc] < 0) {
+			e->pr[doc] = strtod(pr + 1, NULL);
+			e->rank_of[doc] = lineno;
+		}
+		lineno++;
 	}
 
-	int tmp = 0;
-	int i = 0;
-	while (fscanf(fp, "%m[^,],%d,%lf\n", &(arr[i].url), &tmp, &(arr[i].pr)) != EOF)
-		i++;
-
-	// in the end arr has one empty element at the back of the array
-	// i can choose to realloc the array here but it seems pretty
-	// unnecessary to do so
-
+	free(line);
 	fclose(fp);
-	return arr;
-}
-
-static void free_pr(pr_t *arr, int size)
-{
-	// is i < size because the last url in struct is NULL
-	for (int i = 0; i < size; i++) {
-		free(arr[i].url);
-	}
-	free(arr);
 }
 
 static char *str_lower(char *str)
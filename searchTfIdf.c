@@ -1,13 +1,21 @@
+// getopt is POSIX
+#define _POSIX_C_SOURCE 200809L
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <assert.h>
 #include <math.h>
 #include <ctype.h>
+#include <unistd.h>
+#include <getopt.h>
 
 #include "parser.h"
 #include "invindex.h"
-#include "urltable.h"
+#include "match.h"
+#include "topk.h"
+#include "serve.h"
+#include "stats.h"
+#include "perf.h"
 
 #ifndef DUMP_ERR
 #define DUMP_ERR(ptr, str)				\
@@ -17,123 +25,216 @@
 	}
 #endif
 
-typedef struct {
-	char *url;
-	double tfidf;
-} tfidf_t;
-
 static double tf(char *, handle_t);
-static double idf(char *, handle_t);
-static double tfidf(char *, handle_t, handle_t);
-static tfidf_t *copy_url(url_t *, int);
-static void print_tfidf(tfidf_t *, int);
-static void sortby_tfidf(tfidf_t *, int, char **, handle_t);
-static void free_tfidf_arr(tfidf_t *, int);
+static double idf(int, int);
+static double tfidf(char *, handle_t, int, int);
+static double page_tfidf(char *, char **, const int *, int);
+static double index_tfidf(const match_t *, const int *, int, int, int);
+static void search(void *, int, char **, FILE *);
 static char *str_lower(char *str);
 
+// everything a query needs, loaded once
+struct engine {
+	invindex_t ind;
+	handle_t cltn;
+	int limit;	// maximum number of results
+	perf_t perf;	// hardware counters, NULL if off
+};
+
 int main(int argc, char **argv)
 {
-	if (argc < 2) {
-		fprintf(stderr, "Usage: %s [search_terms]\n", argv[0]);
-		exit(EXIT_FAILURE);
-	}
+	int from_stdin = 0;
+	char *sock = NULL;
+	int limit = 30;
+	// --stats[=file], dumps timings as JSON to @stats_path or stderr;
+	// --perf adds hardware counters to them
+	static const struct option longopts[] = {
+		{ "stats", optional_argument, NULL, 'S' },
+		{ "perf", no_argument, NULL, 'P' },
+		{ NULL, 0, NULL, 0 }
+	};
+	char *stats_path = NULL;
+	int perf = 0;
+	int c;
 
-	int nquery = argc - 1;
-	char **query = &argv[1];
+	while ((c = getopt_long(argc, argv, "n:ds:", longopts, NULL)) != -1) {
+		switch (c) {
+		case 'S':
+			stats_enable();
+			stats_path = optarg;
+			break;
+		case 'P':
+			perf = 1;
+			break;
+		case 'n':
+			limit = atoi(optarg);
+			break;
+		case 'd':
+			from_stdin = 1;
+			break;
+		case 's':
+			sock = optarg;
+			break;
+		default:
+			argc = 0;
+		}
+	}
 
-	// normalise words
-	for (int i = 0; i < nquery; i++)
-		str_lower(query[i]);
+	const int server = from_stdin || sock;
+	if (argc == 0 || limit < 0 || (!server && optind >= argc) ||
+	    (server && optind < argc)) {
+		fprintf(stderr, "Usage: %s [-n results] [--stats[=file]] [--perf] "
+			"[-d | -s socket | search_terms]\n", argv[0]);
+		exit(EXIT_FAILURE);
+	}
 
 	// init data structures
-	handle_t cltn = parse("collection.txt");
-	invindex_t ind = read_index("invertedIndex.txt");
-	urltable_t t = new_table(nquery);
-
-	// find associated url for each keyword
-	// insert those urls into table
-	for (int i = 0; i < nquery; i++) {
-		int row_size = 0;
-		char **urls = url_for(ind, query[i], &row_size);
-		if (urls)
-			insert_many(t, i, urls, row_size);
-		else
-			nquery--;
-	}
-	// count number of repeated urls in table
-	set_count(t);
-
-	int urlsize = 0;
-	// take union of urls 
-	url_t *url = table_to_arr(t, &urlsize);
-
-	for (int i = nquery; i > 0; i--) {
-		int subarr_size = 0;
-		// disect array into partition based on "url count"
-		url_t *subarr = partition_arr(url, urlsize, i, &subarr_size);
-		tfidf_t *tfidf = copy_url(subarr, subarr_size);
-		sortby_tfidf(tfidf, subarr_size, query, cltn);
-		print_tfidf(tfidf, subarr_size);
-		free_tfidf_arr(tfidf, subarr_size);
-		free(subarr);
+	struct engine e;
+	if (perf) stats_enable();
+	e.perf = perf ? new_perf() : NULL;
+	e.limit = limit;
+	e.cltn = parse("collection.txt");
+	// prefer the binary index written by inverted, it only decodes the
+	// query terms
+	doctab_t docs = NULL;
+	double t = stats_start();
+	e.ind = map_index("invertedIndex.bin", NULL);
+	if (e.ind == NULL) {
+		docs = new_doctab(e.cltn);
+		e.ind = read_index("invertedIndex.txt", docs, NULL);
 	}
+	stats_stop("load_index", t);
+
+	// -d answers queries from stdin, -s from clients of a socket
+	if (sock)
+		serve_socket(sock, search, &e);
+	else if (from_stdin)
+		serve_stream(stdin, stdout, search, &e);
+	else
+		search(&e, argc - optind, &argv[optind], stdout);
 
 	// release memory
-	free_table_arr(url, urlsize);
-	free_index(ind);
-	free_table(t);
-	free_handle(cltn);
+	free_index(e.ind);
+	free_doctab(docs);
+	free_handle(e.cltn);
+	if (stats_enabled())
+		stats_save(stats_path);
+	free_perf(e.perf);
 	return 0;
 }
 
-static tfidf_t *copy_url(url_t *url, int size)
+// print the urls matching the most of the @nquery terms of @query
+static void search(void *arg, int nquery, char **query, FILE *out)
 {
-	tfidf_t *arr = malloc(size * sizeof(tfidf_t));
-	DUMP_ERR(arr, "malloc failed");
-
-	for (int i = 0; i < size; i++) {
-		arr[i].url = malloc(strlen(get_arr_url(url[i])) + 1);
-		DUMP_ERR(arr, "malloc failed");
-		strcpy(arr[i].url, get_arr_url(url[i]));
-		arr[i].tfidf = 0;
+	struct engine *e = arg;
+	invindex_t ind = e->ind;
+
+	// normalise words
+	for (int i = 0; i < nquery; i++)
+		str_lower(query[i]);
+
+	// find associated docs and their term counts for each keyword
+	const unsigned **lists = malloc((nquery + 1) * sizeof(unsigned *));
+	const unsigned **tfs = malloc((nquery + 1) * sizeof(unsigned *));
+	int *sizes = malloc((nquery + 1) * sizeof(int));
+	DUMP_ERR(lists, "malloc failed");
+	DUMP_ERR(tfs, "malloc failed");
+	DUMP_ERR(sizes, "malloc failed");
+	perf_start(e->perf);
+	double t = stats_start();
+	long npostings = 0;
+	for (int i = 0; i < nquery; i++) {
+		lists[i] = docs_for(ind, query[i], &sizes[i]);
+		tfs[i] = tf_for(ind, query[i], &sizes[i]);
+		npostings += sizes[i];
 	}
+	stats_stop("lookup", t);
+	stats_count("queries", 1);
+	stats_count("postings", npostings);
 
-	return arr;
-}
+	// docs with the number of terms they match, most first
+	int nmatch = 0;
+	t = stats_start();
+	match_t *match = merge_postings(lists, has_tf(ind) ? tfs : NULL, sizes,
+					nquery, &nmatch);
+	stats_stop("merge_postings", t);
+	stats_count("candidates", nmatch);
+	perf_stop(e->perf, "match", "posting", npostings);
 
-static void print_tfidf(tfidf_t *tfidf, int size)
-{
-	static int count = 0;
-	for (int i = 0; i < size && count < 30; i++) {
-		printf("%s %.6f\n", tfidf[i].url, tfidf[i].tfidf);
-		count++;
+	// rank by match count then tfidf, ties in match order; an index
+	// written by inverted has the counts tf-idf needs, only an old text
+	// index makes us read the pages
+	t = stats_start();
+	perf_start(e->perf);
+	topk_t top = new_topk(e->limit);
+	for (int i = 0; i < nmatch; i++) {
+		const unsigned doc = match[i].doc;
+		hit_t h = { doc, match[i].count, 0, i };
+		if (has_tf(ind))
+			h.score = index_tfidf(&match[i], sizes, nquery,
+					      doc_len(ind, doc),
+					      handle_size(e->cltn));
+		else
+			h.score = page_tfidf(index_url(ind, doc), query,
+					     sizes, handle_size(e->cltn));
+		topk_add(top, h);
 	}
+
+	int nhit = 0;
+	hit_t *hit = topk_results(top, &nhit);
+	perf_stop(e->perf, "score", "candidate", nmatch);
+	for (int i = 0; i < nhit; i++)
+		fprintf(out, "%s %.6f\n", index_url(ind, hit[i].id),
+			hit[i].score);
+
+	free_topk(top);
+	stats_stop("rank", t);
+	free(match);
+	free(sizes);
+	free(tfs);
+	free(lists);
 }
 
-int _tfidf_cmp(const void *a, const void *b)
+// summation of tfidf of every search term for @url, read from its page;
+// terms with a document frequency @df of 0 are on no page and add nothing
+static double page_tfidf(char *url, char **query, const int *df, int npages)
 {
-	return (*(tfidf_t *)b).tfidf > (*(tfidf_t *)a).tfidf;
+	// open url source
+	char *fname = malloc(strlen(url) + 5);
+	DUMP_ERR(fname, "malloc failed");
+	sprintf(fname, "%s.txt", url);
+	handle_t page = parse_url(fname, "#start Section-2", "#end Section-2");
+
+	double sum = 0;
+	for (int j = 0; query[j] != NULL; j++)
+		if (df[j] > 0)
+			sum += tfidf(query[j], page, df[j], npages);
+
+	free(fname);
+	free_handle(page);
+	return sum;
 }
 
-static void sortby_tfidf(tfidf_t *arr, int size, char **query, handle_t cltn)
+/*
+ * index_tfidf - summation of tfidf of every search term for match @m
+ * @df: length of the posting list of each of the @nquery terms
+ * @len: number of words of the matched doc
+ * @npages: number of pages in the collection
+ *
+ * tf is the term count merge_postings found for the doc over its length
+ * and idf uses the length of the term's posting list, so no page is
+ * opened and no posting list searched.
+ */
+static double index_tfidf(const match_t *m, const int *df, int nquery,
+			  int len, int npages)
 {
-	for (int i = 0; i < size; i++) {
-		// open url source
-		char *fname = malloc(strlen(arr[i].url) + 4);
-		sprintf(fname, "%s.txt", arr[i].url);
-		handle_t page = parse_url(fname, "#start Section-2", "#end Section-2");
-
-		// for each search term
-		// calculate the summation of tfidf for this url
-		for (int j = 0; query[j] != NULL; j++) {
-			arr[i].tfidf += tfidf(query[j], page, cltn);
-		}
-
-		free(fname);
-		free_handle(page);
+	double sum = 0;
+	for (int j = 0; j < nquery; j++) {
+		if (df[j] == 0) continue;
+		sum += ((double) m->tf[j] / (double) len) *
+			log10((double) npages / (double) df[j]);
 	}
-	// sort by tfidf in descending order
-	qsort(arr, size, sizeof(tfidf_t), _tfidf_cmp);
+	return sum;
 }
 
 static double tf(char *word, handle_t page)
@@ -146,42 +247,17 @@ static double tf(char *word, handle_t page)
 	return (double) count / (double) handle_size(page);
 }
 
-// given a corpus, find its idf with @word
-static double idf(char *word, handle_t cltn)
+// idf of a word on @df of the @npages pages, the length of its posting
+// list standing in for a scan of every page
+static double idf(int df, int npages)
 {
-	int count = 0;
-	for (int i = 0; i < handle_size(cltn); i++) {
-		char *fname = malloc(strlen(getbuf(cltn, i)) + 4);
-		DUMP_ERR(fname, "malloc failed");
-		sprintf(fname, "%s.txt", getbuf(cltn, i));
-
-		handle_t page = parse_url(fname, "#start Section-2", "#end Section-2");
-		normalise(page);
-
-		for (int j = 0; j < handle_size(page); j++) {
-			if (strcmp(word, getbuf(page, j)) == 0) {
-				count++;
-				break;
-			}
-		}
-		free(fname);
-		free_handle(page);
-	}
-	assert(count > 0);
-	return log10((double) handle_size(cltn) / (double) abs(count));
+	return log10((double) npages / (double) df);
 }
 
-static double tfidf(char *word, handle_t page, handle_t cltn)
+static double tfidf(char *word, handle_t page, int df, int npages)
 {
 	normalise(page);
-	return tf(word, page) * idf(word, cltn);
-}
-
-static void free_tfidf_arr(tfidf_t *arr, int size)
-{
-	for (int i = 0; i < size; i++)
-		free(arr[i].url);
-	free(arr);
+	return tf(word, page) * idf(df, npages);
 }
 
 static char *str_lower(char *str)
@@ -0,0 +1,179 @@
+// getline, fdopen, open_memstream and sockets are POSIX
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "serve.h"
+
+// macro for dumping error messages
+#ifndef DUMP_ERR
+#define DUMP_ERR(ptr, str)				\
+	if (ptr == NULL) {				\
+		perror(str);				\
+		exit(EXIT_FAILURE);			\
+	}
+#endif
+
+/*
+ * serve_stream - answer queries read from @in until end of file
+ * @out: where the results go, flushed after every query
+ *
+ * The terms of each line are split in place and passed to @fn; a blank
+ * line is a query without terms and gets an empty reply.
+ */
+void serve_stream(FILE *in, FILE *out, query_fn fn, void *arg)
+{
+	char *line = NULL;
+	size_t cap = 0;
+	ssize_t len;
+	int max_query = 8;
+	char **query = malloc((max_query + 1) * sizeof(char *));
+	DUMP_ERR(query, "malloc failed");
+
+	while ((len = getline(&line, &cap, in)) != -1) {
+		int nquery = 0;
+		for (char *tok = strtok(line, " \t\r\n"); tok;
+		     tok = strtok(NULL, " \t\r\n")) {
+			if (nquery == max_query) {
+				max_query *= 2;
+				char **tmp = realloc(query, (max_query + 1) *
+						     sizeof(char *));
+				DUMP_ERR(tmp, "realloc failed");
+				query = tmp;
+			}
+			query[nquery++] = tok;
+		}
+		query[nquery] = NULL;
+
+		if (nquery > 0)
+			fn(arg, nquery, query, out);
+		fputc('\n', out);
+		// the client waits for the blank line before sending more
+		if (fflush(out) != 0)
+			break;
+	}
+
+	free(query);
+	free(line);
+}
+
+// a query function shared by every connection
+struct shared {
+	query_fn fn;
+	void *arg;
+	pthread_mutex_t lock;
+};
+
+// one client of the socket
+struct client {
+	int conn;
+	struct shared *sh;
+};
+
+/*
+ * locked_query - run a query of the shared engine on behalf of a client
+ *
+ * The engines cache decoded posting lists and add up stats as they go,
+ * so only one query runs at a time. The reply is built in memory under
+ * the lock and sent after it, so a client slow to read holds up no one
+ * but itself.
+ */
+static void locked_query(void *arg, int nquery, char **query, FILE *out)
+{
+	struct shared *sh = arg;
+	char *reply = NULL;
+	size_t len = 0;
+	FILE *mem = open_memstream(&reply, &len);
+	DUMP_ERR(mem, "open_memstream failed");
+
+	pthread_mutex_lock(&sh->lock);
+	sh->fn(sh->arg, nquery, query, mem);
+	pthread_mutex_unlock(&sh->lock);
+
+	fclose(mem);
+	fwrite(reply, 1, len, out);
+	free(reply);
+}
+
+// serve one client until it closes its end of the connection
+static void *client_main(void *arg)
+{
+	struct client *c = arg;
+	const int conn2 = dup(c->conn);
+	FILE *in = fdopen(c->conn, "r");
+	FILE *out = conn2 >= 0 ? fdopen(conn2, "w") : NULL;
+	if (in && out) {
+		serve_stream(in, out, locked_query, c->sh);
+	} else {
+		perror("fdopen failed");
+	}
+	if (in) fclose(in); else close(c->conn);
+	if (out) fclose(out); else if (conn2 >= 0) close(conn2);
+	free(c);
+	return NULL;
+}
+
+/*
+ * serve_socket - answer queries from clients of a Unix domain socket
+ * @path: socket to create, replacing any stale one
+ *
+ * Every client gets a thread that serves it until it closes its end of
+ * the connection, so one that stays connected does not keep the others
+ * waiting. Never returns.
+ */
+void serve_socket(char *path, query_fn fn, void *arg)
+{
+	struct sockaddr_un addr;
+	if (strlen(path) >= sizeof(addr.sun_path)) {
+		fprintf(stderr, "%s: socket path too long\n", path);
+		exit(EXIT_FAILURE);
+	}
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, path);
+
+	int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd < 0) {
+		perror("socket failed");
+		exit(EXIT_FAILURE);
+	}
+	unlink(path);
+	if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+	    listen(fd, SOMAXCONN) != 0) {
+		perror("Cannot listen on socket");
+		exit(EXIT_FAILURE);
+	}
+	// a client that goes away mid reply must not take the server down
+	signal(SIGPIPE, SIG_IGN);
+
+	struct shared sh = { .fn = fn, .arg = arg };
+	pthread_mutex_init(&sh.lock, NULL);
+	pthread_attr_t attr;
+	pthread_attr_init(&attr);
+	pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+
+	for (;;) {
+		int conn = accept(fd, NULL, NULL);
+		if (conn < 0) {
+			perror("accept failed");
+			continue;
+		}
+		struct client *c = malloc(sizeof(struct client));
+		DUMP_ERR(c, "malloc failed");
+		c->conn = conn;
+		c->sh = &sh;
+		pthread_t tid;
+		if (pthread_create(&tid, &attr, client_main, c) != 0) {
+			perror("pthread_create failed");
+			close(conn);
+			free(c);
+		}
+	}
+}
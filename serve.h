@@ -0,0 +1,22 @@
+// serve.h ... Interface to the query server of the search tools
+//
+// A query is one line of space separated search terms. The server
+// answers every line it reads with the results of that query followed by
+// an empty line, so a client can send a batch of queries at once and
+// split the replies by blank lines. Queries come from a stream, such as
+// stdin, or from the clients of a Unix domain socket, each served by a
+// thread of its own. Queries still run one at a time, so @fn need not be
+// thread safe.
+
+#ifndef SERVE_H
+#define SERVE_H
+
+#include <stdio.h>
+
+// answer one query of @nquery terms, writing its results to @out
+typedef void (*query_fn)(void *arg, int nquery, char **query, FILE *out);
+
+void serve_stream(FILE *in, FILE *out, query_fn fn, void *arg);
+void serve_socket(char *path, query_fn fn, void *arg);
+
+#endif
@@ -0,0 +1,327 @@
+// weighted spmv kernels with runtime dispatch
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "spmv.h"
+
+// x86 SIMD kernels are compiled with per-function target attributes so
+// the rest of the program does not need -mavx2
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define HAVE_X86_SIMD 1
+#include <immintrin.h>
+#endif
+
+static void spmv_scalar(const int *off, const int *adj, const double *w,
+			const double *x, double *y, int lo, int hi,
+			double a, double b)
+{
+	for (int i = lo; i < hi; i++) {
+		double sum = 0;
+		for (int e = off[i]; e < off[i + 1]; e++)
+			sum += x[adj[e]] * w[e];
+		y[i] = a + b * sum;
+	}
+}
+
+static double l1diff_scalar(const double *p, const double *q, int n)
+{
+	double diff = 0;
+	for (int i = 0; i < n; i++)
+		diff += fabs(p[i] - q[i]);
+	return diff;
+}
+
+static void spmv32_scalar(const int *off, const int *adj, const float *w,
+			  const float *x, float *y, int lo, int hi,
+			  double a, double b)
+{
+	for (int i = lo; i < hi; i++) {
+		double sum = 0;
+		for (int e = off[i]; e < off[i + 1]; e++)
+			sum += (double)x[adj[e]] * w[e];
+		y[i] = (float)(a + b * sum);
+	}
+}
+
+static double l1diff32_scalar(const float *p, const float *q, int n)
+{
+	double diff = 0;
+	for (int i = 0; i < n; i++)
+		diff += fabs((double)p[i] - q[i]);
+	return diff;
+}
+
+/*
+ * spmv_inplace - Gauss-Seidel sweep over urls [lo, hi)
+ *
+ * Same formula as the spmv kernels, but y[lo .. hi) is updated in place
+ * and must hold the current ranks on entry. In-links inside the range
+ * read the already updated values from @y, the others read @x. With a
+ * single range covering every url this is a plain Gauss-Seidel sweep.
+ * Returns the L1 norm of the change over the range.
+ */
+double spmv_inplace(const int *off, const int *adj, const double *w,
+		    const double *x, double *y, int lo, int hi,
+		    double a, double b)
+{
+	double diff = 0;
+	for (int i = lo; i < hi; i++) {
+		double sum = 0;
+		for (int e = off[i]; e < off[i + 1]; e++) {
+			const int src = adj[e];
+			sum += (src >= lo && src < hi ? y[src] : x[src]) * w[e];
+		}
+		const double old = y[i];
+		y[i] = a + b * sum;
+		diff += fabs(y[i] - old);
+	}
+	return diff;
+}
+
+#ifdef HAVE_X86_SIMD
+
+__attribute__((target("avx2,fma")))
+static void spmv_avx2(const int *off, const int *adj, const double *w,
+		      const double *x, double *y, int lo, int hi,
+		      double a, double b)
+{
+	for (int i = lo; i < hi; i++) {
+		const int end = off[i + 1];
+		int e = off[i];
+		__m256d acc = _mm256_setzero_pd();
+		// gather 4 ranks at a time
+		for (; e + 4 <= end; e += 4) {
+			__m128i idx = _mm_loadu_si128((const __m128i *)&adj[e]);
+			__m256d xv = _mm256_i32gather_pd(x, idx, 8);
+			acc = _mm256_fmadd_pd(xv, _mm256_loadu_pd(&w[e]), acc);
+		}
+		__m128d s = _mm_add_pd(_mm256_castpd256_pd128(acc),
+				       _mm256_extractf128_pd(acc, 1));
+		double sum = _mm_cvtsd_f64(_mm_add_sd(s, _mm_unpackhi_pd(s, s)));
+		for (; e < end; e++)
+			sum += x[adj[e]] * w[e];
+		y[i] = a + b * sum;
+	}
+}
+
+__attribute__((target("avx2")))
+static double l1diff_avx2(const double *p, const double *q, int n)
+{
+	// clearing the sign bit is fabs
+	const __m256d mask =
+		_mm256_castsi256_pd(_mm256_set1_epi64x(0x7fffffffffffffffLL));
+	__m256d acc = _mm256_setzero_pd();
+	int i = 0;
+	for (; i + 4 <= n; i += 4) {
+		__m256d d = _mm256_sub_pd(_mm256_loadu_pd(&p[i]),
+					  _mm256_loadu_pd(&q[i]));
+		acc = _mm256_add_pd(acc, _mm256_and_pd(d, mask));
+	}
+	__m128d s = _mm_add_pd(_mm256_castpd256_pd128(acc),
+			       _mm256_extractf128_pd(acc, 1));
+	double diff = _mm_cvtsd_f64(_mm_add_sd(s, _mm_unpackhi_pd(s, s)));
+	for (; i < n; i++)
+		diff += fabs(p[i] - q[i]);
+	return diff;
+}
+
+__attribute__((target("avx2,fma")))
+static void spmv32_avx2(const int *off, const int *adj, const float *w,
+			const float *x, float *y, int lo, int hi,
+			double a, double b)
+{
+	for (int i = lo; i < hi; i++) {
+		const int end = off[i + 1];
+		int e = off[i];
+		__m256d acc = _mm256_setzero_pd();
+		// gather 4 ranks at a time, widened to double
+		for (; e + 4 <= end; e += 4) {
+			__m128i idx = _mm_loadu_si128((const __m128i *)&adj[e]);
+			__m256d xv = _mm256_cvtps_pd(_mm_i32gather_ps(x, idx, 4));
+			__m256d wv = _mm256_cvtps_pd(_mm_loadu_ps(&w[e]));
+			acc = _mm256_fmadd_pd(xv, wv, acc);
+		}
+		__m128d s = _mm_add_pd(_mm256_castpd256_pd128(acc),
+				       _mm256_extractf128_pd(acc, 1));
+		double sum = _mm_cvtsd_f64(_mm_add_sd(s, _mm_unpackhi_pd(s, s)));
+		for (; e < end; e++)
+			sum += (double)x[adj[e]] * w[e];
+		y[i] = (float)(a + b * sum);
+	}
+}
+
+__attribute__((target("avx2")))
+static double l1diff32_avx2(const float *p, const float *q, int n)
+{
+	const __m256d mask =
+		_mm256_castsi256_pd(_mm256_set1_epi64x(0x7fffffffffffffffLL));
+	__m256d acc = _mm256_setzero_pd();
+	int i = 0;
+	for (; i + 4 <= n; i += 4) {
+		__m256d d = _mm256_sub_pd(_mm256_cvtps_pd(_mm_loadu_ps(&p[i])),
+					  _mm256_cvtps_pd(_mm_loadu_ps(&q[i])));
+		acc = _mm256_add_pd(acc, _mm256_and_pd(d, mask));
+	}
+	__m128d s = _mm_add_pd(_mm256_castpd256_pd128(acc),
+			       _mm256_extractf128_pd(acc, 1));
+	double diff = _mm_cvtsd_f64(_mm_add_sd(s, _mm_unpackhi_pd(s, s)));
+	for (; i < n; i++)
+		diff += fabs((double)p[i] - q[i]);
+	return diff;
+}
+
+__attribute__((target("avx512f")))
+static void spmv_avx512(const int *off, const int *adj, const double *w,
+			const double *x, double *y, int lo, int hi,
+			double a, double b)
+{
+	for (int i = lo; i < hi; i++) {
+		const int end = off[i + 1];
+		int e = off[i];
+		__m512d acc = _mm512_setzero_pd();
+		// gather 8 ranks at a time, then a masked gather for the tail
+		for (; e + 8 <= end; e += 8) {
+			__m256i idx = _mm256_loadu_si256((const __m256i *)&adj[e]);
+			__m512d xv = _mm512_i32gather_pd(idx, x, 8);
+			acc = _mm512_fmadd_pd(xv, _mm512_loadu_pd(&w[e]), acc);
+		}
+		if (e < end) {
+			const __mmask8 k = (__mmask8)((1u << (end - e)) - 1);
+			__m256i idx = _mm512_castsi512_si256(
+				_mm512_maskz_loadu_epi32(k, &adj[e]));
+			__m512d xv = _mm512_mask_i32gather_pd(
+				_mm512_setzero_pd(), k, idx, x, 8);
+			__m512d wv = _mm512_maskz_loadu_pd(k, &w[e]);
+			acc = _mm512_fmadd_pd(xv, wv, acc);
+		}
+		y[i] = a + b * _mm512_reduce_add_pd(acc);
+	}
+}
+
+__attribute__((target("avx512f")))
+static double l1diff_avx512(const double *p, const double *q, int n)
+{
+	__m512d acc = _mm512_setzero_pd();
+	int i = 0;
+	for (; i + 8 <= n; i += 8) {
+		__m512d d = _mm512_sub_pd(_mm512_loadu_pd(&p[i]),
+					  _mm512_loadu_pd(&q[i]));
+		acc = _mm512_add_pd(acc, _mm512_abs_pd(d));
+	}
+	if (i < n) {
+		const __mmask8 k = (__mmask8)((1u << (n - i)) - 1);
+		__m512d d = _mm512_sub_pd(_mm512_maskz_loadu_pd(k, &p[i]),
+					  _mm512_maskz_loadu_pd(k, &q[i]));
+		acc = _mm512_add_pd(acc, _mm512_abs_pd(d));
+	}
+	return _mm512_reduce_add_pd(acc);
+}
+
+__attribute__((target("avx512f")))
+static void spmv32_avx512(const int *off, const int *adj, const float *w,
+			  const float *x, float *y, int lo, int hi,
+			  double a, double b)
+{
+	for (int i = lo; i < hi; i++) {
+		const int end = off[i + 1];
+		int e = off[i];
+		__m512d acc = _mm512_setzero_pd();
+		// gather 8 ranks at a time as floats and widen them to
+		// double, then a masked gather for the tail
+		for (; e + 8 <= end; e += 8) {
+			__m256i idx = _mm256_loadu_si256((const __m256i *)&adj[e]);
+			__m512d xv = _mm512_cvtps_pd(_mm256_i32gather_ps(x, idx, 4));
+			__m512d wv = _mm512_cvtps_pd(_mm256_loadu_ps(&w[e]));
+			acc = _mm512_fmadd_pd(xv, wv, acc);
+		}
+		if (e < end) {
+			const __mmask16 k = (__mmask16)((1u << (end - e)) - 1);
+			__m512i idx = _mm512_maskz_loadu_epi32(k, &adj[e]);
+			__m512 xs = _mm512_mask_i32gather_ps(_mm512_setzero_ps(),
+							     k, idx, x, 4);
+			__m512 ws = _mm512_maskz_loadu_ps(k, &w[e]);
+			acc = _mm512_fmadd_pd(
+				_mm512_cvtps_pd(_mm512_castps512_ps256(xs)),
+				_mm512_cvtps_pd(_mm512_castps512_ps256(ws)), acc);
+		}
+		y[i] = (float)(a + b * _mm512_reduce_add_pd(acc));
+	}
+}
+
+__attribute__((target("avx512f")))
+static double l1diff32_avx512(const float *p, const float *q, int n)
+{
+	__m512d acc = _mm512_setzero_pd();
+	for (int i = 0; i < n; i += 8) {
+		const int m = n - i < 8 ? n - i : 8;
+		const __mmask8 k = (__mmask8)((1u << m) - 1);
+		__m512d d = _mm512_sub_pd(
+			_mm512_cvtps_pd(_mm512_castps512_ps256(
+				_mm512_maskz_loadu_ps(k, &p[i]))),
+			_mm512_cvtps_pd(_mm512_castps512_ps256(
+				_mm512_maskz_loadu_ps(k, &q[i]))));
+		acc = _mm512_add_pd(acc, _mm512_abs_pd(d));
+	}
+	return _mm512_reduce_add_pd(acc);
+}
+
+#endif
+
+// every kernel, best first
+static const kernel_t kernels[] = {
+#ifdef HAVE_X86_SIMD
+	{ "avx512", spmv_avx512, l1diff_avx512, spmv32_avx512,
+	  l1diff32_avx512 },
+	{ "avx2", spmv_avx2, l1diff_avx2, spmv32_avx2, l1diff32_avx2 },
+#endif
+	{ "scalar", spmv_scalar, l1diff_scalar, spmv32_scalar,
+	  l1diff32_scalar },
+};
+
+#define NKERNELS ((int)(sizeof(kernels) / sizeof(kernels[0])))
+
+// check if the cpu can run @k
+static int supported(const kernel_t *k)
+{
+#ifdef HAVE_X86_SIMD
+	__builtin_cpu_init();
+	if (strcmp(k->name, "avx512") == 0)
+		return __builtin_cpu_supports("avx512f");
+	if (strcmp(k->name, "avx2") == 0)
+		return __builtin_cpu_supports("avx2") &&
+			__builtin_cpu_supports("fma");
+#endif
+	return 1;
+}
+
+// fastest kernel the cpu supports
+const kernel_t *best_kernel(void)
+{
+	for (int i = 0; i < NKERNELS; i++)
+		if (supported(&kernels[i]))
+			return &kernels[i];
+	// scalar is always supported
+	return &kernels[NKERNELS - 1];
+}
+
+// kernel called @name, NULL if it does not exist or the cpu lacks it
+const kernel_t *find_kernel(const char *name)
+{
+	for (int i = 0; i < NKERNELS; i++)
+		if (strcmp(kernels[i].name, name) == 0)
+			return supported(&kernels[i]) ? &kernels[i] : NULL;
+	return NULL;
+}
+
+// supported kernels, best first; the first *@n entries are valid
+const kernel_t *get_kernels(int *n)
+{
+	// unsupported kernels sort first, skip them
+	int first = 0;
+	while (first < NKERNELS - 1 && !supported(&kernels[first]))
+		first++;
+	*n = NKERNELS - first;
+	return &kernels[first];
+}
@@ -0,0 +1,42 @@
+// spmv.h ... Interface to the weighted sparse matrix-vector kernels
+//
+// The PageRank inner loop is y[i] = a + b * sum(x[adj[e]] * w[e]) over
+// the in-edges e of url i, followed by the L1 norm of the rank change.
+// Each kernel comes in a scalar flavour and, on x86, AVX2 and AVX-512
+// flavours picked at runtime by CPU feature detection.
+//
+// The 32 bit variants keep x, y and w in single precision, halving the
+// bytes read per edge, but sum and take differences in double so the
+// rounding error does not grow with the number of in-links.
+
+#ifndef SPMV_H
+#define SPMV_H
+
+// y[i] = a + b * sum(x[adj[e]] * w[e], off[i] <= e < off[i + 1]),
+// for lo <= i < hi
+typedef void (*spmv_fn)(const int *off, const int *adj, const double *w,
+			const double *x, double *y, int lo, int hi,
+			double a, double b);
+// sum(fabs(p[i] - q[i]), 0 <= i < n)
+typedef double (*l1diff_fn)(const double *p, const double *q, int n);
+typedef void (*spmv32_fn)(const int *off, const int *adj, const float *w,
+			  const float *x, float *y, int lo, int hi,
+			  double a, double b);
+typedef double (*l1diff32_fn)(const float *p, const float *q, int n);
+
+typedef struct {
+	const char *name;
+	spmv_fn spmv;
+	l1diff_fn l1diff;
+	spmv32_fn spmv32;
+	l1diff32_fn l1diff32;
+} kernel_t;
+
+const kernel_t *best_kernel(void);
+const kernel_t *find_kernel(const char *);
+const kernel_t *get_kernels(int *);
+double spmv_inplace(const int *off, const int *adj, const double *w,
+		    const double *x, double *y, int lo, int hi,
+		    double a, double b);
+
+#endif
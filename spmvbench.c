@@ -0,0 +1,184 @@
+// micro-benchmark for the spmv kernels
+//
+// Builds a random in-link graph with skewed (power-law like) sources and
+// reports edges/second of every kernel the cpu supports, along with the
+// largest deviation from the scalar result, then the same for the 32 bit
+// kernels, which read single precision ranks and weights. The
+// cache-blocked loop of
+// tile.h is timed last, with tiles of the given side or of the size
+// picked for this machine; try millions of vertices to see it pay off.
+
+// clock_gettime is POSIX
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <time.h>
+
+#include "spmv.h"
+#include "tile.h"
+
+#define DUMP_ERR(ptr, str)				\
+	if (ptr == NULL) {				\
+		perror(str);				\
+		exit(EXIT_FAILURE);			\
+	}
+
+static unsigned long long rng = 88172645463325252ULL;
+
+// xorshift64, deterministic across runs
+static unsigned long long next_rand(void)
+{
+	rng ^= rng << 13;
+	rng ^= rng >> 7;
+	rng ^= rng << 17;
+	return rng;
+}
+
+static double now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+int main(int argc, char **argv)
+{
+	if (argc != 4 && argc != 5) {
+		fprintf(stderr, "Usage: %s [nvertices] [avgdegree] [iterations] "
+			"[tileSize]\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	const int nv = atoi(argv[1]);
+	const int deg = atoi(argv[2]);
+	const int iter = atoi(argv[3]);
+	const int size = argc == 5 ? atoi(argv[4]) : tile_size();
+	if (nv < 1 || deg < 0 || iter < 1) {
+		fprintf(stderr, "arguments must be positive\n");
+		return EXIT_FAILURE;
+	}
+	if (size < MIN_TILE) {
+		fprintf(stderr, "tileSize must be at least %d\n", MIN_TILE);
+		return EXIT_FAILURE;
+	}
+
+	int *off = malloc((nv + 1) * sizeof(int));
+	DUMP_ERR(off, "malloc failed");
+	off[0] = 0;
+	for (int i = 0; i < nv; i++)
+		off[i + 1] = off[i] + (int)(next_rand() % (2 * deg + 1));
+	const int ne = off[nv];
+
+	int *adj = malloc((ne + 1) * sizeof(int));
+	double *w = malloc((ne + 1) * sizeof(double));
+	double *x = malloc(nv * sizeof(double));
+	double *y = malloc(nv * sizeof(double));
+	double *ref = malloc(nv * sizeof(double));
+	DUMP_ERR(adj, "malloc failed");
+	DUMP_ERR(w, "malloc failed");
+	DUMP_ERR(x, "malloc failed");
+	DUMP_ERR(y, "malloc failed");
+	DUMP_ERR(ref, "malloc failed");
+
+	for (int e = 0; e < ne; e++) {
+		// cube of a uniform number favours low ids, like popular pages
+		double u = (next_rand() >> 11) * (1.0 / 9007199254740992.0);
+		adj[e] = (int)(nv * u * u * u);
+		w[e] = (next_rand() % 1000 + 1) * 1e-3;
+	}
+	for (int i = 0; i < nv; i++)
+		x[i] = 1.0 / nv;
+
+	int nk = 0;
+	const kernel_t *k = get_kernels(&nk);
+	// scalar is always last
+	k[nk - 1].spmv(off, adj, w, x, ref, 0, nv, 0.15 / nv, 0.85);
+
+	printf("%d vertices, %d edges, %d iterations\n", nv, ne, iter);
+	for (int i = 0; i < nk; i++) {
+		double t = now();
+		for (int j = 0; j < iter; j++)
+			k[i].spmv(off, adj, w, x, y, 0, nv, 0.15 / nv, 0.85);
+		const double t_spmv = now() - t;
+
+		double sink = 0;
+		t = now();
+		for (int j = 0; j < iter; j++)
+			sink += k[i].l1diff(y, x, nv);
+		const double t_diff = now() - t;
+
+		double dev = 0;
+		for (int v = 0; v < nv; v++)
+			dev = fmax(dev, fabs(y[v] - ref[v]));
+
+		printf("%-8s spmv %8.1f Medges/s  l1diff %8.1f Melems/s  "
+		       "max dev %.3g (%g)\n", k[i].name,
+		       (double)ne * iter / t_spmv * 1e-6,
+		       (double)nv * iter / t_diff * 1e-6, dev, sink / iter);
+	}
+
+	float *w32 = malloc((ne + 1) * sizeof(float));
+	float *x32 = malloc(nv * sizeof(float));
+	float *y32 = malloc(nv * sizeof(float));
+	DUMP_ERR(w32, "malloc failed");
+	DUMP_ERR(x32, "malloc failed");
+	DUMP_ERR(y32, "malloc failed");
+	for (int e = 0; e < ne; e++)
+		w32[e] = (float)w[e];
+	for (int v = 0; v < nv; v++)
+		x32[v] = (float)x[v];
+	for (int i = 0; i < nk; i++) {
+		double t = now();
+		for (int j = 0; j < iter; j++)
+			k[i].spmv32(off, adj, w32, x32, y32, 0, nv, 0.15 / nv, 0.85);
+		const double t_spmv = now() - t;
+
+		double sink = 0;
+		t = now();
+		for (int j = 0; j < iter; j++)
+			sink += k[i].l1diff32(y32, x32, nv);
+		const double t_diff = now() - t;
+
+		double dev = 0;
+		for (int v = 0; v < nv; v++)
+			dev = fmax(dev, fabs(y32[v] - ref[v]));
+
+		printf("%-8s spmv32 %6.1f Medges/s  l1diff %8.1f Melems/s  "
+		       "max dev %.3g (%g)\n", k[i].name,
+		       (double)ne * iter / t_spmv * 1e-6,
+		       (double)nv * iter / t_diff * 1e-6, dev, sink / iter);
+	}
+	free(w32);
+	free(x32);
+	free(y32);
+
+	// one part covering every vertex
+	const int bound[2] = { 0, nv };
+	double t = now();
+	tiles_t tiles = new_tiles(off, adj, w, bound, 1, size);
+	const double t_build = now() - t;
+	double sink = 0;
+	t = now();
+	for (int j = 0; j < iter; j++)
+		sink += tiles_spmv(tiles, 0, x, y, 0.15 / nv, 0.85);
+	const double t_tiled = now() - t;
+
+	double dev = 0;
+	for (int v = 0; v < nv; v++)
+		dev = fmax(dev, fabs(y[v] - ref[v]));
+	printf("%-8s spmv %8.1f Medges/s  with l1diff, %ld tiles of %d, "
+	       "built in %.1f ms  max dev %.3g (%g)\n", "tiled",
+	       (double)ne * iter / t_tiled * 1e-6, tiles_count(tiles),
+	       tiles_side(tiles), t_build * 1e3, dev, sink / iter);
+	free_tiles(tiles);
+
+	free(off);
+	free(adj);
+	free(w);
+	free(x);
+	free(y);
+	free(ref);
+	return 0;
+}
@@ -0,0 +1,214 @@
+// timers, counters and samples dumped as JSON
+
+// clock_gettime is POSIX
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "stats.h"
+
+// macro for dumping error messages
+#ifndef DUMP_ERR
+#define DUMP_ERR(ptr, str)				\
+	if (ptr == NULL) {				\
+		perror(str);				\
+		exit(EXIT_FAILURE);			\
+	}
+#endif
+
+// distinct names of each kind, extra names are dropped
+#define MAX_STATS 64
+
+struct timer {
+	const char *name;
+	long calls;
+	double total;	// seconds
+	double max;
+};
+
+struct counter {
+	const char *name;
+	long value;
+};
+
+struct value {
+	const char *name;
+	double v;
+};
+
+struct series {
+	const char *name;
+	double *v;
+	int size;
+	int max_size;
+};
+
+/*
+ * Entries keep a copy of their name and are found by a linear scan;
+ * there are only a few of each.
+ */
+static struct {
+	int on;
+	pthread_mutex_t lock;
+	struct timer timer[MAX_STATS];
+	struct counter counter[MAX_STATS];
+	struct value value[MAX_STATS];
+	struct series series[MAX_STATS];
+	int ntimer;
+	int ncounter;
+	int nvalue;
+	int nseries;
+} st = { .lock = PTHREAD_MUTEX_INITIALIZER };
+
+// start recording
+void stats_enable(void)
+{
+	st.on = 1;
+}
+
+int stats_enabled(void)
+{
+	return st.on;
+}
+
+// monotonic time in seconds, 0 while disabled
+double stats_start(void)
+{
+	if (!st.on) return 0;
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// index of @name in an array of @n entries of @size bytes, which must
+// start with the name; a new entry is added if there is room, -1 if not
+static int find(void *arr, int *n, size_t size, const char *name)
+{
+	for (int i = 0; i < *n; i++) {
+		const char *s = *(const char **)((char *)arr + i * size);
+		if (strcmp(s, name) == 0)
+			return i;
+	}
+	if (*n == MAX_STATS)
+		return -1;
+	char *e = (char *)arr + *n * size;
+	memset(e, 0, size);
+	char *copy = strdup(name);
+	DUMP_ERR(copy, "strdup failed");
+	*(const char **)e = copy;
+	return (*n)++;
+}
+
+// add the time since @start to timer @name, return it in seconds
+double stats_stop(const char *name, double start)
+{
+	if (!st.on) return 0;
+	const double t = stats_start() - start;
+
+	pthread_mutex_lock(&st.lock);
+	int i = find(st.timer, &st.ntimer, sizeof(struct timer), name);
+	if (i >= 0) {
+		st.timer[i].calls++;
+		st.timer[i].total += t;
+		if (t > st.timer[i].max) st.timer[i].max = t;
+	}
+	pthread_mutex_unlock(&st.lock);
+	return t;
+}
+
+// add @n to counter @name
+void stats_count(const char *name, long n)
+{
+	if (!st.on) return;
+
+	pthread_mutex_lock(&st.lock);
+	int i = find(st.counter, &st.ncounter, sizeof(struct counter), name);
+	if (i >= 0)
+		st.counter[i].value += n;
+	pthread_mutex_unlock(&st.lock);
+}
+
+// set value @name to @v, replacing what it held
+void stats_set(const char *name, double v)
+{
+	if (!st.on) return;
+
+	pthread_mutex_lock(&st.lock);
+	int i = find(st.value, &st.nvalue, sizeof(struct value), name);
+	if (i >= 0)
+		st.value[i].v = v;
+	pthread_mutex_unlock(&st.lock);
+}
+
+// append @v to series @name
+void stats_sample(const char *name, double v)
+{
+	if (!st.on) return;
+
+	pthread_mutex_lock(&st.lock);
+	int i = find(st.series, &st.nseries, sizeof(struct series), name);
+	if (i >= 0) {
+		struct series *s = &st.series[i];
+		if (s->size == s->max_size) {
+			s->max_size = s->max_size ? 2 * s->max_size : 16;
+			double *tmp = realloc(s->v, s->max_size * sizeof(double));
+			DUMP_ERR(tmp, "realloc failed");
+			s->v = tmp;
+		}
+		s->v[s->size++] = v;
+	}
+	pthread_mutex_unlock(&st.lock);
+}
+
+/*
+ * stats_dump - write everything recorded as one JSON object
+ *
+ *	{ "timers": { name: { "calls", "total_ms", "max_ms" }, ... },
+ *	  "counters": { name: value, ... },
+ *	  "values": { name: value, ... },
+ *	  "series": { name: [ v, ... ], ... } }
+ */
+void stats_dump(FILE *fp)
+{
+	pthread_mutex_lock(&st.lock);
+	fprintf(fp, "{\n  \"timers\": {");
+	for (int i = 0; i < st.ntimer; i++)
+		fprintf(fp, "%s\n    \"%s\": { \"calls\": %ld, \"total_ms\": %.3f, "
+			"\"max_ms\": %.3f }", i ? "," : "", st.timer[i].name,
+			st.timer[i].calls, st.timer[i].total * 1e3,
+			st.timer[i].max * 1e3);
+	fprintf(fp, "\n  },\n  \"counters\": {");
+	for (int i = 0; i < st.ncounter; i++)
+		fprintf(fp, "%s\n    \"%s\": %ld", i ? "," : "",
+			st.counter[i].name, st.counter[i].value);
+	fprintf(fp, "\n  },\n  \"values\": {");
+	for (int i = 0; i < st.nvalue; i++)
+		fprintf(fp, "%s\n    \"%s\": %.10g", i ? "," : "",
+			st.value[i].name, st.value[i].v);
+	fprintf(fp, "\n  },\n  \"series\": {");
+	for (int i = 0; i < st.nseries; i++) {
+		fprintf(fp, "%s\n    \"%s\": [", i ? "," : "", st.series[i].name);
+		for (int j = 0; j < st.series[i].size; j++)
+			fprintf(fp, "%s%.10g", j ? ", " : "", st.series[i].v[j]);
+		fputc(']', fp);
+	}
+	fprintf(fp, "\n  }\n}\n");
+	fflush(fp);
+	pthread_mutex_unlock(&st.lock);
+}
+
+// dump to the file at @path, or to stderr if @path is NULL
+void stats_save(const char *path)
+{
+	FILE *fp = path ? fopen(path, "w") : stderr;
+	if (fp == NULL) {
+		perror(path);
+		return;
+	}
+	stats_dump(fp);
+	if (path) fclose(fp);
+}
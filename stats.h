@@ -0,0 +1,27 @@
+// stats.h ... Interface to run time instrumentation
+//
+// Named timers, counters, values and series of samples, kept for the whole run
+// and dumped as JSON at the end. Nothing is recorded, and the clock is
+// not read, until stats_enable is called, so the calls can stay in the
+// hot paths. Updates are thread safe.
+//
+//	double t = stats_start();
+//	...
+//	stats_stop("get_graph", t);
+
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdio.h>
+
+void stats_enable(void);
+int stats_enabled(void);
+double stats_start(void);
+double stats_stop(const char *, double);
+void stats_count(const char *, long);
+void stats_set(const char *, double);
+void stats_sample(const char *, double);
+void stats_dump(FILE *);
+void stats_save(const char *);
+
+#endif
@@ -0,0 +1,187 @@
+// string interning with open addressing
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <assert.h>
+#include <string.h>
+
+#include "strtab.h"
+
+// macro for dumping error messages
+#ifndef DUMP_ERR
+#define DUMP_ERR(ptr, str)				\
+	if (ptr == NULL) {				\
+		perror(str);				\
+		exit(EXIT_FAILURE);			\
+	}
+#endif
+
+// empty slot in the hash table
+#define EMPTY -1
+
+struct _strtab {
+	// @size - number of strings
+	// @max_size - capacity of @off and @hash
+	// @nslot - number of hash slots, always a power of 2
+	int size;
+	int max_size;
+	int nslot;
+	// @slot - open addressing table of ids, EMPTY if unused
+	// @hash - cached hash of each id, used when rehashing
+	// @off - offset of each string in @arena
+	int *slot;
+	unsigned *hash;
+	size_t *off;
+	// @arena - every string, '\0' separated
+	// @arena_len - bytes used in @arena
+	// @arena_max - capacity of @arena
+	char *arena;
+	size_t arena_len;
+	size_t arena_max;
+};
+
+static unsigned hash_str(const char *, size_t *);
+static int probe(strtab_t, const char *, unsigned);
+static void grow_slots(strtab_t);
+
+strtab_t new_strtab(void)
+{
+	strtab_t t = malloc(sizeof(struct _strtab));
+	DUMP_ERR(t, "malloc failed");
+
+	t->size = t->max_size = 0;
+	t->nslot = 16;
+	t->slot = malloc(t->nslot * sizeof(int));
+	DUMP_ERR(t->slot, "malloc failed");
+	for (int i = 0; i < t->nslot; i++) t->slot[i] = EMPTY;
+	t->hash = NULL;
+	t->off = NULL;
+	t->arena = NULL;
+	t->arena_len = t->arena_max = 0;
+
+	return t;
+}
+
+void free_strtab(strtab_t t)
+{
+	if (t == NULL) return;
+	free(t->slot);
+	free(t->hash);
+	free(t->off);
+	free(t->arena);
+	free(t);
+}
+
+// 32-bit FNV-1a, also reports the string length through @len
+static unsigned hash_str(const char *str, size_t *len)
+{
+	unsigned h = 2166136261u;
+	const char *p = str;
+	for (; *p; p++) {
+		h ^= (unsigned char)*p;
+		h *= 16777619u;
+	}
+	*len = p - str;
+	return h;
+}
+
+// return the slot holding @str, or the empty slot where it belongs
+static int probe(strtab_t t, const char *str, unsigned h)
+{
+	const unsigned mask = t->nslot - 1;
+	unsigned i = h & mask;
+	while (t->slot[i] != EMPTY) {
+		int id = t->slot[i];
+		if (t->hash[id] == h && strcmp(t->arena + t->off[id], str) == 0)
+			break;
+		i = (i + 1) & mask;
+	}
+	return i;
+}
+
+// double the number of slots and reinsert every id
+static void grow_slots(strtab_t t)
+{
+	const int new_size = 2 * t->nslot;
+	int *tmp = malloc(new_size * sizeof(int));
+	DUMP_ERR(tmp, "malloc failed");
+	for (int i = 0; i < new_size; i++) tmp[i] = EMPTY;
+
+	const unsigned mask = new_size - 1;
+	for (int id = 0; id < t->size; id++) {
+		unsigned i = t->hash[id] & mask;
+		while (tmp[i] != EMPTY) i = (i + 1) & mask;
+		tmp[i] = id;
+	}
+
+	free(t->slot);
+	t->slot = tmp;
+	t->nslot = new_size;
+}
+
+// return the id of @str, adding it to the table if not present
+int intern_str(strtab_t t, const char *str)
+{
+	assert(t && str);
+
+	size_t len;
+	unsigned h = hash_str(str, &len);
+	int i = probe(t, str, h);
+	if (t->slot[i] != EMPTY)
+		return t->slot[i];
+
+	if (t->size >= t->max_size) {
+		int new_size = t->max_size == 0 ? 16 : 2 * t->max_size;
+		unsigned *htmp = realloc(t->hash, new_size * sizeof(unsigned));
+		DUMP_ERR(htmp, "realloc failed");
+		t->hash = htmp;
+		size_t *otmp = realloc(t->off, new_size * sizeof(size_t));
+		DUMP_ERR(otmp, "realloc failed");
+		t->off = otmp;
+		t->max_size = new_size;
+	}
+	if (t->arena_len + len + 1 > t->arena_max) {
+		size_t new_size = t->arena_max == 0 ? 256 : 2 * t->arena_max;
+		while (new_size < t->arena_len + len + 1) new_size *= 2;
+		char *tmp = realloc(t->arena, new_size);
+		DUMP_ERR(tmp, "realloc failed");
+		t->arena = tmp;
+		t->arena_max = new_size;
+	}
+
+	const int id = t->size++;
+	t->hash[id] = h;
+	t->off[id] = t->arena_len;
+	memcpy(t->arena + t->arena_len, str, len + 1);
+	t->arena_len += len + 1;
+	t->slot[i] = id;
+
+	// keep load factor under 1/2
+	if (2 * t->size > t->nslot) grow_slots(t);
+
+	return id;
+}
+
+// return the id of @str, -1 if not present
+int find_str(strtab_t t, const char *str)
+{
+	assert(t && str);
+	size_t len;
+	unsigned h = hash_str(str, &len);
+	return t->slot[probe(t, str, h)];
+}
+
+// the returned string lives in the arena and may move on the next
+// intern_str, copy it if it has to outlive that
+char *id_to_str(strtab_t t, int id)
+{
+	assert(t);
+	assert(id >= 0 && id < t->size);
+	return t->arena + t->off[id];
+}
+
+int strtab_size(strtab_t t)
+{
+	assert(t);
+	return t->size;
+}
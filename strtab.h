@@ -0,0 +1,19 @@
+// strtab.h ... Interface to an interning table of strings
+//
+// Maps strings to dense ids 0, 1, 2 ... in insertion order. All strings
+// are kept in a single arena so the table costs one allocation per growth
+// step rather than one per string.
+
+#ifndef STRTAB_H
+#define STRTAB_H
+
+typedef struct _strtab *strtab_t;
+
+strtab_t new_strtab(void);
+void free_strtab(strtab_t);
+int intern_str(strtab_t, const char *);
+int find_str(strtab_t, const char *);
+char *id_to_str(strtab_t, int);
+int strtab_size(strtab_t);
+
+#endif
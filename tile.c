@@ -0,0 +1,190 @@
+// cache-blocked weighted spmv over (destination, source) tiles
+
+// sysconf is POSIX
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <assert.h>
+#include <unistd.h>
+
+#include "tile.h"
+
+// macro for dumping error messages
+#ifndef DUMP_ERR
+#define DUMP_ERR(ptr, str)				\
+	if (ptr == NULL) {				\
+		perror(str);				\
+		exit(EXIT_FAILURE);			\
+	}
+#endif
+
+// edges of destination block b are row/col/val[edge[b] .. edge[b + 1]),
+// ordered by source block, then by url, then as in the in-link arrays
+struct _tiles {
+	// @size - urls per tile side
+	// @nblock - destination blocks over all parts
+	// @ntiles - tiles holding at least one edge
+	int size;
+	int nblock;
+	long ntiles;
+	// @part - first destination block of each part
+	// @lo - first url of each destination block
+	// @edge - first edge of each destination block
+	int *part;
+	int *lo;
+	int *edge;
+	int *row;
+	int *col;
+	double *val;
+};
+
+/*
+ * new_tiles - lay in-links out in tiles
+ * @off, @adj, @w: in-links of urls [0, bound[@nparts]) and their weights
+ * @bound: part i owns urls [bound[i], bound[i + 1])
+ * @size: urls per tile side, at least MIN_TILE
+ *
+ * One counting pass per destination block, O(V + E + tiles).
+ */
+tiles_t new_tiles(const int *off, const int *adj, const double *w,
+		  const int *bound, int nparts, int size)
+{
+	assert(size >= MIN_TILE);
+	tiles_t t = malloc(sizeof(struct _tiles));
+	DUMP_ERR(t, "malloc failed");
+	const int nv = bound[nparts];
+	const int nsrc = nv / size + 1;
+	const int ne = off[nv];
+	t->size = size;
+	t->ntiles = 0;
+
+	t->part = malloc((nparts + 1) * sizeof(int));
+	DUMP_ERR(t->part, "malloc failed");
+	t->nblock = 0;
+	for (int p = 0; p < nparts; p++) {
+		t->part[p] = t->nblock;
+		t->nblock += (bound[p + 1] - bound[p] + size - 1) / size;
+	}
+	t->part[nparts] = t->nblock;
+
+	t->lo = malloc((t->nblock + 1) * sizeof(int));
+	t->edge = malloc((t->nblock + 1) * sizeof(int));
+	t->row = malloc(((size_t)ne + 1) * sizeof(int));
+	t->col = malloc(((size_t)ne + 1) * sizeof(int));
+	t->val = malloc(((size_t)ne + 1) * sizeof(double));
+	int *cur = malloc((nsrc + 1) * sizeof(int));
+	DUMP_ERR(t->lo, "malloc failed");
+	DUMP_ERR(t->edge, "malloc failed");
+	DUMP_ERR(t->row, "malloc failed");
+	DUMP_ERR(t->col, "malloc failed");
+	DUMP_ERR(t->val, "malloc failed");
+	DUMP_ERR(cur, "malloc failed");
+
+	int b = 0;
+	for (int p = 0; p < nparts; p++)
+		for (int lo = bound[p]; lo < bound[p + 1]; lo += size)
+			t->lo[b++] = lo;
+	t->lo[t->nblock] = nv;
+
+	for (b = 0; b < t->nblock; b++) {
+		const int lo = t->lo[b];
+		// a block never crosses into the next part
+		int hi = lo + size;
+		if (t->lo[b + 1] < hi) hi = t->lo[b + 1];
+
+		// edges per source block, then where each block starts
+		memset(cur, 0, (nsrc + 1) * sizeof(int));
+		for (int e = off[lo]; e < off[hi]; e++)
+			cur[adj[e] / size + 1]++;
+		cur[0] = off[lo];
+		for (int s = 0; s < nsrc; s++) {
+			t->ntiles += cur[s + 1] > 0;
+			cur[s + 1] += cur[s];
+		}
+
+		for (int i = lo; i < hi; i++)
+			for (int e = off[i]; e < off[i + 1]; e++) {
+				const int k = cur[adj[e] / size]++;
+				t->row[k] = i;
+				t->col[k] = adj[e];
+				t->val[k] = w[e];
+			}
+		t->edge[b] = off[lo];
+	}
+	t->edge[t->nblock] = ne;
+
+	free(cur);
+	return t;
+}
+
+/*
+ * tiles_spmv - y[i] = a + b * sum(x[src] * w) over the urls of @part
+ *
+ * Returns the L1 norm of y - x over them, like spmv_inplace. y doubles
+ * as the accumulator, each block of it is cleared before its tiles run.
+ */
+double tiles_spmv(tiles_t t, int part, const double *x, double *y,
+		  double a, double b)
+{
+	double diff = 0;
+	for (int bl = t->part[part]; bl < t->part[part + 1]; bl++) {
+		const int lo = t->lo[bl];
+		int hi = lo + t->size;
+		if (t->lo[bl + 1] < hi) hi = t->lo[bl + 1];
+
+		memset(y + lo, 0, (hi - lo) * sizeof(double));
+		for (int e = t->edge[bl]; e < t->edge[bl + 1]; e++)
+			y[t->row[e]] += x[t->col[e]] * t->val[e];
+
+		for (int i = lo; i < hi; i++) {
+			y[i] = a + b * y[i];
+			diff += fabs(y[i] - x[i]);
+		}
+	}
+	return diff;
+}
+
+/*
+ * tile_size - tile side for this machine
+ *
+ * A source and a destination slice of doubles fill half of the L2
+ * cache, leaving room for the edges streaming through. Assumes 1 MiB
+ * where the size is unknown.
+ */
+int tile_size(void)
+{
+	long cache = -1;
+#ifdef _SC_LEVEL2_CACHE_SIZE
+	cache = sysconf(_SC_LEVEL2_CACHE_SIZE);
+#endif
+	if (cache <= 0) cache = 1L << 20;
+	const long size = cache / 4 / sizeof(double);
+	return size < MIN_TILE ? MIN_TILE : (int)size;
+}
+
+// urls per tile side
+int tiles_side(tiles_t t)
+{
+	return t->size;
+}
+
+// tiles holding at least one edge
+long tiles_count(tiles_t t)
+{
+	return t->ntiles;
+}
+
+void free_tiles(tiles_t t)
+{
+	if (t == NULL) return;
+	free(t->part);
+	free(t->lo);
+	free(t->edge);
+	free(t->row);
+	free(t->col);
+	free(t->val);
+	free(t);
+}
@@ -0,0 +1,31 @@
+// tile.h ... Interface to the cache-blocked spmv
+//
+// Once the rank vector outgrows the cache, the row-wise kernels miss on
+// nearly every x[adj[e]]. Tiling cuts the in-links into a grid of
+// (destination block, source block) tiles, @size urls a side, and lays
+// the edges of every destination block out tile after tile. While a tile
+// is processed only a @size slice of x is read and a @size slice of y
+// written, so both stay in cache.
+//
+// Each thread owns the destination blocks of its range of urls, as set
+// by the partition the row-wise kernels use. With in-links sorted by
+// source, as graph.c keeps them, every url sums its in-links in the same
+// order as the scalar kernel and gets the same rank.
+
+#ifndef TILE_H
+#define TILE_H
+
+// smallest tile side, keeps the number of tiles in check
+#define MIN_TILE 1024
+
+typedef struct _tiles *tiles_t;
+
+tiles_t new_tiles(const int *off, const int *adj, const double *w,
+		  const int *bound, int nparts, int size);
+double tiles_spmv(tiles_t, int, const double *, double *, double, double);
+int tile_size(void);
+int tiles_side(tiles_t);
+long tiles_count(tiles_t);
+void free_tiles(tiles_t);
+
+#endif
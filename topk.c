@@ -0,0 +1,116 @@
+// bounded min-heap of the best k hits
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+
+#include "topk.h"
+
+// macro for dumping error messages
+#ifndef DUMP_ERR
+#define DUMP_ERR(ptr, str)				\
+	if (ptr == NULL) {				\
+		perror(str);				\
+		exit(EXIT_FAILURE);			\
+	}
+#endif
+
+/*
+ * The worst hit kept is at the root, so a new hit only has to beat the
+ * root to get in. topk_results heap sorts the array in place, after
+ * which hits are in rank order and no more can be added.
+ */
+struct _topk {
+	hit_t *heap;
+	int size;
+	int k;
+	int done;	// set once the heap has been sorted
+};
+
+// whether @a ranks before @b
+static int better(const hit_t *a, const hit_t *b)
+{
+	if (a->count != b->count)
+		return a->count > b->count;
+	if (a->score != b->score)
+		return a->score > b->score;
+	return a->seq < b->seq;
+}
+
+static void swap(hit_t *a, hit_t *b)
+{
+	hit_t tmp = *a;
+	*a = *b;
+	*b = tmp;
+}
+
+// move @heap[i] down until both children rank before it
+static void sift_down(hit_t *heap, int n, int i)
+{
+	for (;;) {
+		int worst = i;
+		const int l = 2 * i + 1;
+		const int r = l + 1;
+		if (l < n && better(&heap[worst], &heap[l])) worst = l;
+		if (r < n && better(&heap[worst], &heap[r])) worst = r;
+		if (worst == i) return;
+		swap(&heap[i], &heap[worst]);
+		i = worst;
+	}
+}
+
+// keep the best @k hits, @k may be 0
+topk_t new_topk(int k)
+{
+	assert(k >= 0);
+	topk_t t = malloc(sizeof(struct _topk));
+	DUMP_ERR(t, "malloc failed");
+	t->heap = malloc((k + 1) * sizeof(hit_t));
+	DUMP_ERR(t->heap, "malloc failed");
+	t->size = 0;
+	t->k = k;
+	t->done = 0;
+	return t;
+}
+
+// offer @h, it is dropped unless it ranks among the best k so far
+void topk_add(topk_t t, hit_t h)
+{
+	assert(t && !t->done);
+
+	if (t->size < t->k) {
+		// sift up
+		int i = t->size++;
+		t->heap[i] = h;
+		while (i > 0 && better(&t->heap[(i - 1) / 2], &t->heap[i])) {
+			swap(&t->heap[i], &t->heap[(i - 1) / 2]);
+			i = (i - 1) / 2;
+		}
+	} else if (t->k > 0 && better(&h, &t->heap[0])) {
+		t->heap[0] = h;
+		sift_down(t->heap, t->size, 0);
+	}
+}
+
+// return the hits kept, best first; the array is owned by @t
+hit_t *topk_results(topk_t t, int *size)
+{
+	assert(t);
+	if (!t->done) {
+		// popping the worst to the back leaves the best at the front
+		for (int n = t->size - 1; n > 0; n--) {
+			swap(&t->heap[0], &t->heap[n]);
+			sift_down(t->heap, n, 0);
+		}
+		t->done = 1;
+	}
+	*size = t->size;
+	return t->heap;
+}
+
+void free_topk(topk_t t)
+{
+	assert(t);
+	free(t->heap);
+	free(t);
+}
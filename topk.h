@@ -0,0 +1,24 @@
+// topk.h ... Interface to bounded top-k selection of search results
+//
+// Hits are ranked by the number of query terms they match, then by
+// score, then by the order they were added in. Only the best k are
+// kept, in a heap, so adding n hits costs O(n log k).
+
+#ifndef TOPK_H
+#define TOPK_H
+
+typedef struct _topk *topk_t;
+
+typedef struct {
+	unsigned id;	// what the hit refers to, up to the caller
+	int count;	// number of query terms matched
+	double score;
+	unsigned seq;	// smaller wins ties
+} hit_t;
+
+topk_t new_topk(int);
+void topk_add(topk_t, hit_t);
+hit_t *topk_results(topk_t, int *);
+void free_topk(topk_t);
+
+#endif
@@ -17,28 +17,34 @@ struct _url {
 };
 
 // url struct LIST
+// the list, its urls and their strings all live in @mem
 struct _urll {
 	int size;
 	url_t *li;
+	arena_t mem;
+	int own_mem;	// @mem is freed with the list
 };
 
 // takes in graph and collection to generate a list of url_t
-urll_t new_url_list(graph_t g, handle_t cltn)
+// the list is allocated from @mem, or from its own arena if NULL
+urll_t new_url_list(graph_t g, handle_t cltn, arena_t mem)
 {
-	urll_t url_li = malloc(sizeof(struct _urll));
-	if (url_li == NULL) exit(EXIT_FAILURE);
+	const int own_mem = mem == NULL;
+	if (own_mem) mem = new_arena(0);
 
+	urll_t url_li = arena_alloc(mem, sizeof(struct _urll));
+	url_li->mem = mem;
+	url_li->own_mem = own_mem;
 	url_li->size = handle_size(cltn);
-	url_li->li = malloc(url_li->size * sizeof(url_t));
+	url_li->li = arena_alloc(mem, url_li->size * sizeof(url_t));
 
 	// init url_t struct
 	for (int i = 0; i < url_li->size; i++) {
-		url_li->li[i] = malloc(sizeof(struct _url));
+		url_li->li[i] = arena_alloc(mem, sizeof(struct _url));
 		// assign to var to make it more readable
 		url_t u = url_li->li[i];
 
-		u->url = malloc(strlen(getbuf(cltn, i)) + 1);
-		strcpy(u->url, getbuf(cltn, i));
+		u->url = arena_strdup(mem, getbuf(cltn, i));
 
 		u->out_degree = outdegree(g, i);
 		u->in_degree = indegree(g, i);
@@ -71,16 +77,11 @@ double getwpr(urll_t list, int id)
 /* 	return list->li[id]->inlinks; */
 /* } */
 
+// everything is in the arena, a shared one is left to its owner
 void free_list(urll_t list)
 {
-	for (int i = 0; i < list->size; i++) {
-		free(list->li[i]->url);
-		/* free(list->li[i]->inlinks); */
-		/* free(list->li[i]->outlinks); */
-		free(list->li[i]);
-	}
-	free(list->li);
-	free(list);
+	if (list->own_mem)
+		free_arena(list->mem);
 }
 
 int _cmp_wpr(const void *a, const void *b)
@@ -3,13 +3,14 @@
 
 #include "graph.h"
 #include "parser.h"
+#include "arena.h"
 
 // url struct
 typedef struct _url *url_t;
 // url list struct
 typedef struct _urll *urll_t;
 
-urll_t new_url_list(graph_t, handle_t);
+urll_t new_url_list(graph_t, handle_t, arena_t);
 double getwpr(urll_t list, int id);
 void setwpr(urll_t, int, double);
 void output(urll_t, char *);
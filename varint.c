@@ -0,0 +1,77 @@
+// varint and delta coding of doc id lists and term counts
+
+#include "varint.h"
+
+// write @v to @buf, return the number of bytes written
+int put_varint(unsigned char *buf, unsigned v)
+{
+	int n = 0;
+	while (v >= 0x80) {
+		buf[n++] = (v & 0x7f) | 0x80;
+		v >>= 7;
+	}
+	buf[n++] = v;
+	return n;
+}
+
+// read one integer from @buf into *@v, return the number of bytes read
+int get_varint(const unsigned char *buf, unsigned *v)
+{
+	unsigned x = 0;
+	int n = 0;
+	int shift = 0;
+	while (buf[n] & 0x80) {
+		x |= (unsigned)(buf[n++] & 0x7f) << shift;
+		shift += 7;
+	}
+	x |= (unsigned)buf[n++] << shift;
+	*v = x;
+	return n;
+}
+
+// encode @n ascending ids as gaps, @out needs room for n * VARINT_MAX
+// bytes; return the number of bytes written
+size_t encode_deltas(const unsigned *ids, int n, unsigned char *out)
+{
+	size_t len = 0;
+	unsigned prev = 0;
+	for (int i = 0; i < n; i++) {
+		len += put_varint(out + len, ids[i] - prev);
+		prev = ids[i];
+	}
+	return len;
+}
+
+// decode @n ids written by encode_deltas, return the number of bytes read
+size_t decode_deltas(const unsigned char *in, int n, unsigned *ids)
+{
+	size_t len = 0;
+	unsigned prev = 0;
+	for (int i = 0; i < n; i++) {
+		unsigned gap;
+		len += get_varint(in + len, &gap);
+		prev += gap;
+		ids[i] = prev;
+	}
+	return len;
+}
+
+// encode @n integers as they are, @out needs room for n * VARINT_MAX
+// bytes; return the number of bytes written
+size_t encode_varints(const unsigned *v, int n, unsigned char *out)
+{
+	size_t len = 0;
+	for (int i = 0; i < n; i++)
+		len += put_varint(out + len, v[i]);
+	return len;
+}
+
+// decode @n integers written by encode_varints, return the number of
+// bytes read
+size_t decode_varints(const unsigned char *in, int n, unsigned *v)
+{
+	size_t len = 0;
+	for (int i = 0; i < n; i++)
+		len += get_varint(in + len, &v[i]);
+	return len;
+}
@@ -0,0 +1,23 @@
+// varint.h ... Interface to variable length integer coding
+//
+// Integers are stored 7 bits per byte, low bits first, with the top bit
+// of every byte but the last set. Sorted doc id lists are stored as the
+// gaps between consecutive ids, which are small and mostly fit in a byte.
+// Other small counts, such as term frequencies, are stored as they are.
+
+#ifndef VARINT_H
+#define VARINT_H
+
+#include <stddef.h>
+
+// maximum number of bytes of one encoded 32-bit integer
+#define VARINT_MAX 5
+
+int put_varint(unsigned char *, unsigned);
+int get_varint(const unsigned char *, unsigned *);
+size_t encode_deltas(const unsigned *, int, unsigned char *);
+size_t decode_deltas(const unsigned char *, int, unsigned *);
+size_t encode_varints(const unsigned *, int, unsigned char *);
+size_t decode_varints(const unsigned char *, int, unsigned *);
+
+#endif
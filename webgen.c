@@ -0,0 +1,220 @@
+// synthetic web collection generator for benchmarks
+//
+// Writes collection.txt and one urlN.txt per page into a directory, in
+// the format pagerank and inverted read. Out-degrees follow a power law
+// and link targets a Zipf law over a shuffled page order, so a few pages
+// collect most links as on the web. Words of Section-2 are drawn from a
+// Zipf law over a made up vocabulary, some capitalised or followed by
+// punctuation so that normalise has work to do. The same seed always
+// gives the same collection.
+
+// mkdir is POSIX
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#define DUMP_ERR(ptr, str)				\
+	if (ptr == NULL) {				\
+		perror(str);				\
+		exit(EXIT_FAILURE);			\
+	}
+
+// urls per line of Section-1 and collection.txt, words per line of
+// Section-2
+#define URLS_PER_LINE 5
+#define WORDS_PER_LINE 10
+
+static unsigned long long rng = 88172645463325252ULL;
+
+// xorshift64, deterministic across runs
+static unsigned long long next_rand(void)
+{
+	rng ^= rng << 13;
+	rng ^= rng >> 7;
+	rng ^= rng << 17;
+	return rng;
+}
+
+// uniform in [0, 1)
+static double uniform(void)
+{
+	return (next_rand() >> 11) * (1.0 / 9007199254740992.0);
+}
+
+// cumulative distribution of a Zipf law with exponent @s over @n ranks
+static double *zipf_cdf(int n, double s)
+{
+	double *cdf = malloc((n + 1) * sizeof(double));
+	DUMP_ERR(cdf, "malloc failed");
+	double sum = 0;
+	for (int i = 0; i < n; i++) {
+		sum += 1.0 / pow(i + 1, s);
+		cdf[i] = sum;
+	}
+	for (int i = 0; i < n; i++)
+		cdf[i] /= sum;
+	return cdf;
+}
+
+// draw a rank in [0, n) from @cdf
+static int zipf(const double *cdf, int n)
+{
+	const double u = uniform();
+	int lo = 0;
+	int hi = n - 1;
+	while (lo < hi) {
+		const int mid = lo + (hi - lo) / 2;
+		if (cdf[mid] < u)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
+// number of links of a page, power law with exponent 2.5 and mean @mean
+static int out_degree(double mean, int max)
+{
+	// x_min * u^(-1 / (a - 1)) has mean x_min * (a - 1) / (a - 2)
+	const double x_min = mean / 3;
+	const double x = x_min * pow(1 - uniform(), -1 / 1.5);
+	return x > max ? max : (int)x;
+}
+
+// write word @k of the vocabulary to @buf, one syllable per base 100 digit
+static void make_word(int k, char *buf)
+{
+	static const char *consonant = "bcdfghjklmnprstvwxyz";
+	static const char *vowel = "aeiou";
+	int n = 0;
+	for (unsigned v = k + 1; v > 0; v /= 100) {
+		buf[n++] = consonant[v % 100 / 5];
+		buf[n++] = vowel[v % 5];
+	}
+	buf[n] = '\0';
+}
+
+static FILE *open_in(const char *dir, const char *name)
+{
+	char path[4096];
+	snprintf(path, sizeof(path), "%s/%s", dir, name);
+	FILE *fp = fopen(path, "w");
+	DUMP_ERR(fp, path);
+	return fp;
+}
+
+int main(int argc, char **argv)
+{
+	int npages = 10000;
+	double degree = 10;
+	int nwords = 100;
+	int vocab = 5000;
+	int c;
+
+	while ((c = getopt(argc, argv, "n:d:w:v:s:")) != -1) {
+		switch (c) {
+		case 'n':
+			npages = atoi(optarg);
+			break;
+		case 'd':
+			degree = atof(optarg);
+			break;
+		case 'w':
+			nwords = atoi(optarg);
+			break;
+		case 'v':
+			vocab = atoi(optarg);
+			break;
+		case 's':
+			rng = strtoull(optarg, NULL, 10) * 2654435761ULL + 1;
+			break;
+		default:
+			argc = 0;
+		}
+	}
+
+	if (argc - optind != 1 || npages < 2 || degree < 0 || nwords < 1 ||
+	    vocab < 1) {
+		fprintf(stderr, "Usage: %s [-n pages] [-d outdegree] "
+			"[-w words per page] [-v vocabulary] [-s seed] dir\n",
+			argv[0]);
+		return EXIT_FAILURE;
+	}
+	const char *dir = argv[optind];
+	if (mkdir(dir, 0755) != 0 && errno != EEXIST) {
+		perror(dir);
+		return EXIT_FAILURE;
+	}
+
+	// popularity rank -> page, so popular pages are spread over the ids
+	int *page = malloc(npages * sizeof(int));
+	DUMP_ERR(page, "malloc failed");
+	for (int i = 0; i < npages; i++)
+		page[i] = i;
+	for (int i = npages - 1; i > 0; i--) {
+		const int j = next_rand() % (i + 1);
+		int tmp = page[i];
+		page[i] = page[j];
+		page[j] = tmp;
+	}
+	double *link_cdf = zipf_cdf(npages, 1.0);
+	double *word_cdf = zipf_cdf(vocab, 1.0);
+
+	FILE *cltn = open_in(dir, "collection.txt");
+	for (int i = 0; i < npages; i++)
+		fprintf(cltn, "url%d%c", i,
+			(i + 1) % URLS_PER_LINE == 0 || i == npages - 1 ? '\n' : ' ');
+	fclose(cltn);
+
+	long nlinks = 0;
+	char name[64];
+	char word[32];
+	for (int i = 0; i < npages; i++) {
+		snprintf(name, sizeof(name), "url%d.txt", i);
+		FILE *fp = open_in(dir, name);
+
+		fputs("#start Section-1\n\n", fp);
+		const int deg = out_degree(degree, npages - 1);
+		for (int j = 0; j < deg; j++) {
+			int dst = page[zipf(link_cdf, npages)];
+			if (dst == i) dst = (dst + 1) % npages;
+			fprintf(fp, "url%d%c", dst,
+				(j + 1) % URLS_PER_LINE == 0 || j == deg - 1 ?
+				'\n' : ' ');
+		}
+		nlinks += deg;
+		fputs("\n#end Section-1\n\n#start Section-2\n\n", fp);
+
+		for (int j = 0; j < nwords; j++) {
+			make_word(zipf(word_cdf, vocab), word);
+			const unsigned r = next_rand() % 100;
+			if (r < 5)
+				word[0] -= 'a' - 'A';
+			fputs(word, fp);
+			if (r >= 95)
+				fputc(".,;?"[r % 4], fp);
+			fputc((j + 1) % WORDS_PER_LINE == 0 || j == nwords - 1 ?
+			      '\n' : ' ', fp);
+		}
+		fputs("\n#end Section-2\n", fp);
+
+		if (fclose(fp) != 0) {
+			perror(name);
+			return EXIT_FAILURE;
+		}
+	}
+
+	fprintf(stderr, "%s: %d pages, %ld links, %d words per page\n",
+		dir, npages, nlinks, nwords);
+
+	free(page);
+	free(link_cdf);
+	free(word_cdf);
+	return 0;
+}